@@ -3,6 +3,60 @@
 
 namespace AttackTables {
 
+// {rank, file} steps along each ray
+constexpr int ROOK_RAYS[SLIDER_DIR][2] = {{1, 0}, {-1, 0}, {0, 1}, {0, -1}};
+constexpr int BISHOP_RAYS[SLIDER_DIR][2] = {{1, 1}, {1, -1}, {-1, 1}, {-1, -1}};
+
+// Magics found offline with a sparse random search, one per square a1..h8
+constexpr bitboard ROOK_MAGICS[NSQUARES] = {
+    0x1080004008801020ULL, 0x0840092002C03000ULL, 0x1900200010400900ULL,
+    0x0880100008000480ULL, 0x4200100420080200ULL, 0x8100020100080400ULL,
+    0x0200040110886200ULL, 0x0200008040220411ULL, 0x0404800084400220ULL,
+    0x0000401000402000ULL, 0x0086001081220440ULL, 0x0408800800100280ULL,
+    0x000A001201040820ULL, 0x8848800200840080ULL, 0x4001000100040200ULL,
+    0x0442000102105084ULL, 0x9080010020804100ULL, 0x0040404000201009ULL,
+    0x0000808010002009ULL, 0x2200090021D00100ULL, 0x0008008008040080ULL,
+    0x0004004002010040ULL, 0x0011040008015042ULL, 0x00000A0001768104ULL,
+    0x0000800080204009ULL, 0x2010004140002001ULL, 0x9800200280100080ULL,
+    0x1000100080080080ULL, 0x0442000A00049020ULL, 0x2100040080020080ULL,
+    0x0800120400900148ULL, 0x0010040A00128541ULL, 0x2800804000800030ULL,
+    0x1010002000400041ULL, 0x4000200011004100ULL, 0x0610008410800800ULL,
+    0x0400802402800800ULL, 0xC100020080800400ULL, 0x0002000802000401ULL,
+    0x0182085882000401ULL, 0x0220204000808000ULL, 0x2860100040024022ULL,
+    0x0001002004110040ULL, 0x99101042000A0020ULL, 0x0004080004008080ULL,
+    0x0010040002008080ULL, 0x2012004881020004ULL, 0x8300842444820011ULL,
+    0x0088403882010200ULL, 0x0820400080210100ULL, 0x0110910040A00300ULL,
+    0x0801100280080480ULL, 0x0242009008200600ULL, 0x1002000489500200ULL,
+    0x0040800200010080ULL, 0x0091800041000080ULL, 0x0000209300488001ULL,
+    0x04C1002414824001ULL, 0x020020000B001041ULL, 0x7000100004200901ULL,
+    0x8002002004100802ULL, 0x30010002084C0007ULL, 0x0888221800813004ULL,
+    0x4000002840840112ULL,
+};
+constexpr bitboard BISHOP_MAGICS[NSQUARES] = {
+    0xA010041108003100ULL, 0x006082020A002900ULL, 0x6810010619200000ULL,
+    0x08281A0520000408ULL, 0x0001104001000400ULL, 0x0018901008048400ULL,
+    0x00040A0210245280ULL, 0x000200210808A402ULL, 0x9140048410821200ULL,
+    0x0800091010820041ULL, 0x20504804832202C0ULL, 0x0100091401081000ULL,
+    0x8021011140000012ULL, 0x0810020804450400ULL, 0x208B0542109008A2ULL,
+    0x0080084A08040204ULL, 0x0040E2A80811244CULL, 0x2505022008008108ULL,
+    0x0430220100420040ULL, 0x010A040420220040ULL, 0x1105000290400000ULL,
+    0x0093001200822120ULL, 0x4000A62048043004ULL, 0x280120048A015004ULL,
+    0x006090002A020814ULL, 0x44042000240800D0ULL, 0x01102800040A4400ULL,
+    0x1004080080220040ULL, 0x0001001011004024ULL, 0x0010044000805040ULL,
+    0x0914041200820100ULL, 0x0004821012821480ULL, 0x0024040500C05021ULL,
+    0x0088611002080200ULL, 0x0116080A00040020ULL, 0x4000020080080080ULL,
+    0x2450450140840040ULL, 0x0000880201484100ULL, 0x0222020404020092ULL,
+    0x8081110600002E00ULL, 0x2842101105000801ULL, 0x1100809008001025ULL,
+    0x00020202221C0400ULL, 0x0422014022009020ULL, 0x0210046102100C00ULL,
+    0xC004008082029102ULL, 0x00AA461801101200ULL, 0x0404080080201108ULL,
+    0x020542108C205002ULL, 0x0410544804100100ULL, 0x0040910841100000ULL,
+    0x0400200042021100ULL, 0x00004204850400C0ULL, 0x0200100410A42102ULL,
+    0x1040020801210102ULL, 0x0805040410420000ULL, 0x2884804130100200ULL,
+    0x800C262201242000ULL, 0x1058000194108800ULL, 0x0014221054420204ULL,
+    0x0104000012A02200ULL, 0x0200881003300100ULL, 0x0140400202840100ULL,
+    0x0402020801010201ULL,
+};
+
 // Pre-computes attack tables for each non-sliding piece
 void init() {
   for (Square square = a1; square < NSQUARES; ++square) {
@@ -20,6 +74,14 @@ void init() {
     KNIGHT.ATTACKS[starting.square] = compute_attack_bitboard(KNIGHT, starting);
     KING.ATTACKS[starting.square] = compute_attack_bitboard(KING, starting);
   }
+
+  // Pick the slider indexing scheme before the tables are filled with it
+  USE_PEXT = detect_pext();
+
+  // Rooks fill the front of the shared slider table, bishops the back
+  init_magics(ROOK, ROOK_MAGICS, ROOK_RAYS, SLIDER_ATTACKS);
+  init_magics(BISHOP, BISHOP_MAGICS, BISHOP_RAYS,
+              SLIDER_ATTACKS + ROOK_TABLE_SIZE);
 }
 
 // Generates an attack bitboard for a given non-sliding piece at a given square
@@ -52,6 +114,78 @@ auto constexpr compute_attack_bitboard(Attack_Data<n_dir> attack_data,
   return attack_bb;
 }
 
+// PEXT is only worth using where it is implemented in hardware, AMD parts
+// before Zen 3 microcode it and are slower than the multiply-shift lookup
+bool detect_pext() {
+#if defined(__x86_64__) && defined(__GNUC__)
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("bmi2") && !__builtin_cpu_is("znver1") &&
+         !__builtin_cpu_is("znver2");
+#else
+  return false;
+#endif
+}
+
+// Generates a slider's attack bitboard by walking each ray until it leaves
+// the board or runs into a blocker (blockers themselves are attacked)
+auto compute_slider_bitboard(const int rays[SLIDER_DIR][2],
+                             const Square_Data starting,
+                             const bitboard occupancy) -> bitboard {
+  bitboard attack_bb = 0ULL;
+
+  for (size_t i = 0; i < SLIDER_DIR; i++) {
+    int rank = starting.rank + rays[i][0];
+    int file = starting.file + rays[i][1];
+    while ((rank >= 0) & (rank <= 7) & (file >= 0) & (file <= 7)) {
+      Square target = Utils::get_square(rank, file);
+      Utils::set_bit(attack_bb, target);
+      if (Utils::get_bit(occupancy, target)) {
+        break;
+      }
+      rank += rays[i][0];
+      file += rays[i][1];
+    }
+  }
+  return attack_bb;
+}
+
+// Computes the blocker mask of every square and fills its slice of the
+// shared attack table for every subset of blockers
+void init_magics(Magic_Data magics[NSQUARES],
+                 const bitboard magic_numbers[NSQUARES],
+                 const int rays[SLIDER_DIR][2], bitboard *table) {
+  for (Square square = a1; square < NSQUARES; ++square) {
+    Square_Data starting = {
+        square,
+        static_cast<int>(Utils::rank(square)),
+        static_cast<int>(Utils::file(square)),
+    };
+
+    // Edge squares never block a ray, unless the slider sits on that edge
+    bitboard rank_edges = Utils::RANK_MASK[0] | Utils::RANK_MASK[7];
+    bitboard file_edges = Utils::FILE_MASK[0] | Utils::FILE_MASK[7];
+    bitboard edges = (rank_edges & ~Utils::rank_mask(square)) |
+                     (file_edges & ~Utils::file_mask(square));
+
+    Magic_Data &magic = magics[square];
+    magic.MASK = compute_slider_bitboard(rays, starting, 0ULL) & ~edges;
+    magic.MAGIC = magic_numbers[square];
+    magic.SHIFT = 64 - Utils::pop_count(magic.MASK);
+    magic.ATTACKS = table;
+
+    // Carry-Rippler trick enumerates every subset of the mask
+    // (https://www.chessprogramming.org/Traversing_Subsets_of_a_Set)
+    bitboard blockers = 0ULL;
+    do {
+      magic.ATTACKS[magic.index(blockers)] =
+          compute_slider_bitboard(rays, starting, blockers);
+      blockers = (blockers - magic.MASK) & magic.MASK;
+    } while (blockers);
+
+    table += 1ULL << Utils::pop_count(magic.MASK);
+  }
+}
+
 //////////////////////////////////////////////////
 /* Attack_Data declarations for each non-slider */
 //////////////////////////////////////////////////
@@ -100,4 +234,12 @@ Attack_Data<KING_DIR> KING = {
     },
     {},
 };
+
+/////////////////////////////////////////////
+/* Magic_Data declarations for each slider */
+/////////////////////////////////////////////
+bool USE_PEXT = false;
+Magic_Data ROOK[NSQUARES];
+Magic_Data BISHOP[NSQUARES];
+bitboard SLIDER_ATTACKS[ROOK_TABLE_SIZE + BISHOP_TABLE_SIZE];
 } // namespace AttackTables
@@ -27,10 +27,71 @@ extern Attack_Data<KNIGHT_DIR> KNIGHT;
 constexpr size_t KING_DIR = 8;
 extern Attack_Data<KING_DIR> KING;
 
+// Set by init() when the host has a fast BMI2 PEXT instruction
+extern bool USE_PEXT;
+bool detect_pext();
+
+// Issued through inline asm so one binary runs on hosts without BMI2,
+// the instruction is only ever reached when USE_PEXT is set
+// (https://www.chessprogramming.org/BMI2#PEXTBitboards)
+inline bitboard pext(const bitboard bb, const bitboard mask) {
+#if defined(__x86_64__)
+  bitboard result;
+  asm("pextq %2, %1, %0" : "=r"(result) : "r"(bb), "r"(mask));
+  return result;
+#else
+  (void)bb;
+  (void)mask;
+  return 0ULL;
+#endif
+}
+
+// Fancy magic bitboards for sliding pieces
+// (https://www.chessprogramming.org/Magic_Bitboards)
+// Each square owns a slice of one shared attack table, indexed by
+// multiplying the relevant blockers with a magic and keeping the top bits,
+// or by extracting the blocker bits directly with PEXT when available.
+struct Magic_Data {
+  bitboard MASK;
+  bitboard MAGIC;
+  bitboard *ATTACKS;
+  unsigned SHIFT;
+
+  inline size_t index(const bitboard occupancy) const {
+    if (USE_PEXT) {
+      return pext(occupancy, MASK);
+    }
+    return ((occupancy & MASK) * MAGIC) >> SHIFT;
+  }
+};
+
+constexpr size_t SLIDER_DIR = 4;
+constexpr size_t ROOK_TABLE_SIZE = 102400;
+constexpr size_t BISHOP_TABLE_SIZE = 5248;
+extern Magic_Data ROOK[NSQUARES];
+extern Magic_Data BISHOP[NSQUARES];
+extern bitboard SLIDER_ATTACKS[ROOK_TABLE_SIZE + BISHOP_TABLE_SIZE];
+
+inline bitboard rook_attacks(const Square sq, const bitboard occupancy) {
+  return ROOK[sq].ATTACKS[ROOK[sq].index(occupancy)];
+}
+inline bitboard bishop_attacks(const Square sq, const bitboard occupancy) {
+  return BISHOP[sq].ATTACKS[BISHOP[sq].index(occupancy)];
+}
+inline bitboard queen_attacks(const Square sq, const bitboard occupancy) {
+  return rook_attacks(sq, occupancy) | bishop_attacks(sq, occupancy);
+}
+
 void init();
 template<size_t n_dir>
 auto constexpr compute_attack_bitboard(Attack_Data<n_dir> attack_data,
                                  const Square_Data starting) -> bitboard;
+auto compute_slider_bitboard(const int rays[SLIDER_DIR][2],
+                             const Square_Data starting,
+                             const bitboard occupancy) -> bitboard;
+void init_magics(Magic_Data magics[NSQUARES],
+                 const bitboard magic_numbers[NSQUARES],
+                 const int rays[SLIDER_DIR][2], bitboard *table);
 } // namespace AttackTables
 
 #endif
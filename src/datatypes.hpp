@@ -18,7 +18,7 @@ inline Colors operator~(Colors color) {
 }
 
 const int NPIECES = 6;
-enum Pieces : int { PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING };
+enum Pieces : int { PAWN, KNIGHT, BISHOP, ROOK, QUEEN, KING, NO_PIECE };
 std::ostream inline &operator<<(std::ostream &os, const Pieces &pc) {
   char pc_ch[6] = {'p', 'n', 'b', 'r', 'q', 'k'};
   os << pc_ch[pc];
@@ -60,56 +60,63 @@ std::ostream inline &operator<<(std::ostream &os, const Square &sq) {
   return os;
 };
 
-struct Move {
-  Pieces piece;
-  Square from;
-  Square to;
-  bool is_capture = false;
-  Pieces captured_piece;
-  bool is_double_push;
-  bool is_castle;
-  bool is_en_passant;
-  Pieces promotion;
-  int sort_score = 0;
-  explicit inline operator bool() const {
-    return !((piece == PAWN) && (from == a1) && (to == a1) &&
-             (sort_score == 0));
-  }
+// Moves are packed into 16 bits: [0-5] from, [6-11] to, [12-15] flags
+// (https://www.chessprogramming.org/Encoding_Moves)
+// The moving and captured pieces are not stored, they are read off the board.
+enum MoveFlags : uint16_t {
+  QUIET = 0,
+  DOUBLE_PUSH = 1,
+  KING_CASTLE = 2,
+  QUEEN_CASTLE = 3,
+  CAPTURE = 4,
+  EN_PASSANT = 5,
+  // the two lowest bits of a promotion hold the promoted piece - KNIGHT
+  PROMOTION = 8,
 };
-std::ostream inline &operator<<(std::ostream &os, const Move &mv) {
-  os << mv.from << mv.to;
-  if (mv.promotion) {
-    os << mv.promotion;
-  }
-  return os;
+constexpr uint16_t promotion_flag(const Pieces pc) {
+  return PROMOTION | (pc - KNIGHT);
 }
-bool inline operator==(const Move &lhs, const Move &rhs) {
-  if (!(lhs.to == rhs.to)) {
-    return false;
-  }
 
-  if (!(lhs.from == rhs.from)) {
-    return false;
-  }
+struct Move {
+  uint16_t data = 0;
 
-  if (!(lhs.piece == rhs.piece)) {
-    return false;
-  }
+  Move() = default;
+  constexpr Move(const Square from, const Square to,
+                 const uint16_t flags = QUIET)
+      : data(static_cast<uint16_t>(from | (to << 6) | (flags << 12))) {}
 
-  if (!(lhs.is_castle == rhs.is_castle)) {
-    return false;
-  }
-  if (!(lhs.is_capture == rhs.is_capture)) {
-    return false;
+  constexpr Square from() const { return static_cast<Square>(data & 0x3F); }
+  constexpr Square to() const {
+    return static_cast<Square>((data >> 6) & 0x3F);
   }
-  if (!(lhs.is_en_passant == rhs.is_en_passant)) {
-    return false;
+  constexpr uint16_t flags() const { return data >> 12; }
+
+  constexpr bool is_capture() const { return flags() & CAPTURE; }
+  constexpr bool is_promotion() const { return flags() & PROMOTION; }
+  constexpr bool is_en_passant() const { return flags() == EN_PASSANT; }
+  constexpr bool is_double_push() const { return flags() == DOUBLE_PUSH; }
+  constexpr bool is_castle() const {
+    return (flags() == KING_CASTLE) || (flags() == QUEEN_CASTLE);
   }
-  if (!(lhs.is_double_push == rhs.is_double_push)) {
-    return false;
+  constexpr Pieces promotion() const {
+    return static_cast<Pieces>(KNIGHT + (flags() & 3));
   }
 
-  return true;
+  // a1a1 is never a valid move, so an all-zero move doubles as "no move"
+  explicit constexpr operator bool() const { return data != 0; }
+};
+std::ostream inline &operator<<(std::ostream &os, const Move &mv) {
+  os << mv.from() << mv.to();
+  if (mv.is_promotion()) {
+    os << mv.promotion();
+  }
+  return os;
+}
+constexpr bool operator==(const Move &lhs, const Move &rhs) {
+  return lhs.data == rhs.data;
+}
+constexpr bool operator!=(const Move &lhs, const Move &rhs) {
+  return lhs.data != rhs.data;
 }
 
 struct Undo_Info {
@@ -117,28 +124,63 @@ struct Undo_Info {
   int halfmove_clock = 0ULL;
   Square en_passant_square = a1;
   bool castling_flags[4] = {true, true, true, true};
+  Pieces captured_piece = PAWN;
   Move last_move = Move();
 };
 
 const int NNODETYPES = 3;
 enum NodeType : int { EXACT, LOWER, UPPER, NONETYPE };
 
+// 12-byte TT entry, five of them share one 64-byte cluster. Only the low
+// 16 key bits are kept, the cluster index already encodes the high ones.
 struct TT_Entry {
-  zobrist_key key;
-  size_t depth;
-  int evaluation;
-  NodeType type;
+  uint16_t key16;
   Move best_move;
-  size_t age;
+  int32_t evaluation;
+  uint8_t depth;
+  uint8_t type;
+  uint8_t age;
 
   TT_Entry()
-      : key(0ULL), depth(0), evaluation(0), type(NONETYPE), best_move(Move()),
+      : key16(0), best_move(Move()), evaluation(0), depth(0), type(NONETYPE),
         age(0) {}
 
   TT_Entry(zobrist_key key, size_t depth, int evaluation, NodeType node_type,
            Move best_move, size_t age)
-      : key(key), depth(depth), evaluation(evaluation), type(node_type),
-        best_move(best_move), age(age) {}
+      : key16(key & 0xFFFF), best_move(best_move), evaluation(evaluation),
+        depth(depth), type(node_type), age(age) {
+    key16 ^= check();
+  }
+
+  // Lockless hashing (https://www.chessprogramming.org/Shared_Hash_Table)
+  // key16 is stored XORed with a fold of the data, so an entry torn by two
+  // threads writing at once fails to verify instead of being trusted.
+  uint16_t inline check() const {
+    return best_move.data ^ static_cast<uint16_t>(evaluation) ^
+           static_cast<uint16_t>(evaluation >> 16) ^
+           static_cast<uint16_t>(depth | (age << 8)) ^ type;
+  }
+  bool inline matches(const zobrist_key key) const {
+    return ((key16 ^ check()) == (key & 0xFFFF)) && (type != NONETYPE);
+  }
+};
+
+// One cache line worth of entries, a probe touches a single line
+struct alignas(64) TT_Cluster {
+  static constexpr size_t SIZE = 5;
+  TT_Entry entries[SIZE];
+};
+static_assert(sizeof(TT_Cluster) == 64, "TT cluster must fill a cache line");
+
+// Perft hash entry, caches the node count of a subtree at a given depth
+struct Perft_Entry {
+  zobrist_key key;
+  size_t depth;
+  uint64_t nodes;
+
+  Perft_Entry() : key(0ULL), depth(0), nodes(0) {}
+  Perft_Entry(zobrist_key key, size_t depth, uint64_t nodes)
+      : key(key), depth(depth), nodes(nodes) {}
 };
 
 enum Scores : int { DRAW = 0, CHECKMATE = -INT_MAX };
@@ -0,0 +1,27 @@
+#include "history.hpp"
+#include "datatypes.hpp"
+#include <algorithm>
+
+void History::clear() {
+  int *begin = &butterfly[0][0][0];
+  std::fill(begin, begin + sizeof(butterfly) / sizeof(int), 0);
+  begin = &captures[0][0][0];
+  std::fill(begin, begin + sizeof(captures) / sizeof(int), 0);
+  Move *counters = &countermoves[0][0][0];
+  std::fill(counters, counters + sizeof(countermoves) / sizeof(Move), Move());
+  begin = &continuation[0][0][0][0][0][0];
+  std::fill(begin, begin + sizeof(continuation) / sizeof(int), 0);
+}
+
+// Halve everything between searches so old positions fade out, but the
+// ordering learned on the previous move is not thrown away
+void History::age() {
+  auto halve = [](int *begin, const size_t size) {
+    for (int *entry = begin; entry != begin + size; entry++) {
+      *entry /= 2;
+    }
+  };
+  halve(&butterfly[0][0][0], sizeof(butterfly) / sizeof(int));
+  halve(&captures[0][0][0], sizeof(captures) / sizeof(int));
+  halve(&continuation[0][0][0][0][0][0], sizeof(continuation) / sizeof(int));
+}
@@ -0,0 +1,111 @@
+#ifndef HISTORY_HPP_
+#define HISTORY_HPP_
+
+#include "datatypes.hpp"
+#include <algorithm>
+#include <climits>
+#include <cstdlib>
+
+// History scores of a move given by the piece it moves and its to-square
+typedef int PieceToHistory[NPIECES][NSQUARES];
+
+// Move played at one ply of the current line, Move() for a null move, and
+// the static eval of the node it was played from (-INT_MAX in check)
+struct StackEntry {
+  Move move = Move();
+  Pieces piece = NO_PIECE;
+  int static_eval = -INT_MAX;
+};
+
+// Move ordering statistics learned by the search, one instance per thread
+struct History {
+  static constexpr int MAX_HISTORY = 16384;
+  // Continuation histories are kept for the previous move and the one
+  // before it (our own last move)
+  static constexpr size_t CONTINUATION_PLIES = 2;
+
+  // Butterfly history (https://www.chessprogramming.org/History_Heuristic)
+  // indexed by side to move, from and to square
+  int butterfly[NCOLORS][NSQUARES][NSQUARES];
+
+  // Countermove heuristic
+  // (https://www.chessprogramming.org/Countermove_Heuristic)
+  // the quiet refutation of the opponent's last piece and to-square
+  Move countermoves[NCOLORS][NPIECES][NSQUARES];
+
+  // Continuation history, indexed by plies ago, side to move and the
+  // earlier move's piece and to-square, then the current piece and to-square
+  PieceToHistory continuation[CONTINUATION_PLIES][NCOLORS][NPIECES][NSQUARES];
+
+  // Capture history, indexed by moving piece, to-square and captured piece
+  int captures[NPIECES][NSQUARES][NPIECES];
+
+  void clear();
+  void age();
+
+  // Butterfly plus continuation scores of a quiet move, conts holds the
+  // continuation tables of the previous plies (entries may be nullptr)
+  int inline quiet_score(const Colors side, const Pieces piece, const Move mv,
+                         PieceToHistory *const *conts) const {
+    int score = butterfly[side][mv.from()][mv.to()];
+    for (size_t i = 0; i < CONTINUATION_PLIES; i++) {
+      if (conts[i]) {
+        score += (*conts[i])[piece][mv.to()];
+      }
+    }
+    return score;
+  }
+  void inline update_quiet(const Colors side, const Pieces piece,
+                           const Move mv, PieceToHistory *const *conts,
+                           const int bonus) {
+    gravity(butterfly[side][mv.from()][mv.to()], bonus);
+    for (size_t i = 0; i < CONTINUATION_PLIES; i++) {
+      if (conts[i]) {
+        gravity((*conts[i])[piece][mv.to()], bonus);
+      }
+    }
+  }
+
+  int inline capture_score(const Pieces piece, const Move mv,
+                           const Pieces captured) const {
+    return captures[piece][mv.to()][captured];
+  }
+  void inline update_capture(const Pieces piece, const Move mv,
+                             const Pieces captured, const int bonus) {
+    gravity(captures[piece][mv.to()][captured], bonus);
+  }
+
+  Move inline countermove(const Colors side, const StackEntry &prev) const {
+    return prev.move ? countermoves[side][prev.piece][prev.move.to()] : Move();
+  }
+  void inline store_countermove(const Colors side, const StackEntry &prev,
+                                const Move mv) {
+    if (prev.move) {
+      countermoves[side][prev.piece][prev.move.to()] = mv;
+    }
+  }
+
+  // The table continuing from an earlier move, nullptr after a null move or
+  // above the root
+  PieceToHistory inline *continuation_table(const size_t plies_ago,
+                                            const Colors side,
+                                            const StackEntry &prev) {
+    return prev.move ? &continuation[plies_ago][side][prev.piece]
+                                    [prev.move.to()]
+                     : nullptr;
+  }
+
+  // Deeper cutoffs are more trustworthy, capped so one node cannot
+  // saturate an entry on its own
+  static int inline bonus(const int depth) {
+    return std::min(32 * depth * depth, 2048);
+  }
+
+  // History gravity: an entry moves less the closer it already is to
+  // +-MAX_HISTORY, so it stays bounded and favours recent results
+  static void inline gravity(int &entry, const int bonus) {
+    entry += bonus - entry * std::abs(bonus) / MAX_HISTORY;
+  }
+};
+
+#endif
@@ -1,8 +1,13 @@
+#include "attack_tables.hpp"
+#include "search.hpp"
 #include "uci.hpp"
 #include <memory>
 
 int main() {
-  auto uci = std::make_unique<Uci>(Uci());
+  // Global lookup tables, built once and shared read-only by every thread
+  AttackTables::init();
+  Search::init();
+  auto uci = std::make_unique<Uci>();
   uci->loop();
   return 0;
 }
@@ -2,118 +2,268 @@
 #include "attack_tables.hpp"
 #include "datatypes.hpp"
 #include "utils.hpp"
+#include <algorithm>
+#include <atomic>
 #include <chrono>
-#include <iomanip>
+#include <fstream>
 #include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
 
 MoveGenerator::MoveGenerator(std::shared_ptr<Position> position_ptr)
     : pos(position_ptr) {
   new_game();
 };
 
+// Attack tables are global and built once in main(), before any generator
 void MoveGenerator::new_game() {
-  AttackTables::init();
-  initiate_rank_attacks();
+  masks_key = 0ULL;
 }
 
-double MoveGenerator::divide(const size_t depth) {
+// Prints the perft count below each root move
+uint64_t MoveGenerator::divide(const size_t depth, const size_t threads) {
   auto start_time = std::chrono::high_resolution_clock::now();
 
-  std::cout << std::fixed;
-  std::cout << std::setprecision(0);
-  MoveList move_list = MoveList();
-  double nodes;
-  double all_nodes = 0;
+  MoveList move_list = generate_legal_moves();
+  std::vector<std::atomic<uint64_t>> counts(move_list.size());
+  count_root_moves(move_list, counts, depth, threads);
 
-  move_list = generate_pseudo_legal_moves();
+  std::ostringstream report;
+  uint64_t all_nodes = 0;
   for (size_t i = 0; i < move_list.size(); i++) {
-    pos->make_move(move_list.at(i));
-    if (!validate_gamestate()) {
-      pos->undo_move(move_list.at(i));
-      continue;
-    }
-    nodes = perft(depth - 1);
-    all_nodes += nodes;
-    if (nodes > 0) {
-      std::cout << move_list.at(i) << ": " << nodes << "\n";
+    all_nodes += counts[i];
+    if (counts[i] > 0) {
+      report << move_list.at(i) << ": " << counts[i] << "\n";
     }
-    pos->undo_move(move_list.at(i));
   }
+
   auto end_time = std::chrono::high_resolution_clock::now();
   auto time = std::chrono::duration_cast<std::chrono::milliseconds>(end_time -
                                                                     start_time);
+  // Avoid dividing by zero on very shallow perfts
+  uint64_t elapsed = std::max<uint64_t>(time.count(), 1);
+
+  report << "Nodes searched:\t" << all_nodes << "\n";
+  report << "Time searched:\t" << time.count() << "ms\n";
+  report << "Search speed:\t" << all_nodes * 1000 / elapsed << "nps";
+  Utils::print_line(report.str());
+  return all_nodes;
+}
+
+// Runs every position of an EPD perft suite, one per line in the format
+//   <fen> ;D1 <count> ;D2 <count> ...
+// up to max_depth, flags mismatching counts and reports aggregate speed.
+// Depths beyond max_depth are listed as skipped and counted apart from the
+// passed ones. Returns the number of mismatches.
+size_t MoveGenerator::perft_suite(const std::string &path,
+                                  const size_t max_depth,
+                                  const size_t threads) {
+  std::ifstream suite(path);
+  if (!suite) {
+    std::cout << "info string cannot open perft suite " << path << std::endl;
+    return 0;
+  }
+
+  // The suite borrows the UCI position, the game position is put back after
+  const Position game_position = *pos;
+
+  size_t positions = 0;
+  size_t passed = 0;
+  size_t failures = 0;
+  size_t skipped = 0;
+  uint64_t all_nodes = 0;
+  uint64_t all_time = 0;
+
+  std::string line;
+  while (std::getline(suite, line)) {
+    std::istringstream fields(line);
+    std::string fen;
+    std::getline(fields, fen, ';');
+    if (fen.find_first_not_of(" \t\r") == std::string::npos) {
+      continue;
+    }
+    fen.erase(fen.find_last_not_of(" \t\r") + 1);
+    pos->set_board(fen);
+    positions++;
+    std::cout << fen << "\n";
+
+    std::string field;
+    while (std::getline(fields, field, ';')) {
+      if (field.find_first_not_of(" \t\r") == std::string::npos) {
+        continue;
+      }
+      std::istringstream depth_field(field);
+      std::string label;
+      uint64_t expected;
+      // D followed by one or two digits, anything else is reported
+      if (!(depth_field >> label >> expected) || (label.size() < 2) ||
+          (label.size() > 3) || (label[0] != 'D') ||
+          (label.find_first_not_of("0123456789", 1) != std::string::npos)) {
+        std::cout << "  malformed field \"" << field << "\", skipped\n";
+        continue;
+      }
+      size_t depth = std::stoul(label.substr(1));
+      if (depth > max_depth) {
+        skipped++;
+        std::cout << "  D" << depth << ": skipped, over depth " << max_depth
+                  << "\n";
+        continue;
+      }
+
+      auto start_time = std::chrono::high_resolution_clock::now();
+      MoveList move_list = generate_legal_moves();
+      std::vector<std::atomic<uint64_t>> counts(move_list.size());
+      count_root_moves(move_list, counts, depth, threads);
+      uint64_t nodes = 0;
+      for (size_t i = 0; i < move_list.size(); i++) {
+        nodes += counts[i];
+      }
+      auto end_time = std::chrono::high_resolution_clock::now();
+      uint64_t time = std::chrono::duration_cast<std::chrono::milliseconds>(
+                          end_time - start_time)
+                          .count();
+      all_nodes += nodes;
+      all_time += time;
+
+      std::cout << "  D" << depth << ": " << nodes << " " << time << "ms";
+      if (nodes == expected) {
+        passed++;
+        std::cout << " ok\n";
+      } else {
+        failures++;
+        std::cout << " FAIL expected " << expected << "\n";
+      }
+    }
+  }
 
+  *pos = game_position;
+
+  std::cout << "Positions:\t" << positions << "\n";
+  std::cout << "Passed:\t\t" << passed << "\n";
+  std::cout << "Failures:\t" << failures << "\n";
+  std::cout << "Skipped:\t" << skipped << "\n";
   std::cout << "Nodes searched:\t" << all_nodes << "\n";
-  std::cout << "Time searched:\t" << time.count() << "ms\n";
-  std::cout << "Search speed:\t" << all_nodes / (time.count() / 1000.0) << "nps"
+  std::cout << "Time searched:\t" << all_time << "ms\n";
+  std::cout << "Search speed:\t"
+            << all_nodes * 1000 / std::max<uint64_t>(all_time, 1) << "nps"
             << std::endl;
-  std::cout << std::scientific;
-  return all_nodes;
+  return failures;
 }
 
-double MoveGenerator::perft(const size_t depth) {
-  MoveList move_list = MoveList();
-  double nodes = 0;
+// Fills counts[i] with perft(depth - 1) below move_list[i]. With more than
+// one thread the work is split two plies deep, so even a position with only
+// a handful of root moves keeps every core busy. Each worker owns a copy of
+// the position and its own generator; the perft table is shared.
+void MoveGenerator::count_root_moves(MoveList &move_list,
+                                     std::vector<std::atomic<uint64_t>> &counts,
+                                     const size_t depth, const size_t threads) {
+  if ((threads <= 1) || (depth < 3)) {
+    for (size_t i = 0; i < move_list.size(); i++) {
+      pos->make_move(move_list.at(i));
+      counts[i] = (depth > 0) ? perft(depth - 1) : 0;
+      pos->undo_move(move_list.at(i));
+    }
+    return;
+  }
+
+  // (root move index, reply) split points
+  std::vector<std::pair<size_t, Move>> tasks;
+  for (size_t i = 0; i < move_list.size(); i++) {
+    counts[i] = 0;
+    pos->make_move(move_list.at(i));
+    MoveList replies = generate_legal_moves();
+    for (size_t j = 0; j < replies.size(); j++) {
+      tasks.emplace_back(i, replies.at(j));
+    }
+    pos->undo_move(move_list.at(i));
+  }
+
+  // One generator per worker, each with its own position copy
+  std::vector<std::unique_ptr<MoveGenerator>> generators;
+  for (size_t t = 0; t < threads; t++) {
+    generators.push_back(
+        std::make_unique<MoveGenerator>(std::make_shared<Position>(*pos)));
+  }
 
-  if (!validate_gamestate()) {
-    return 0ULL;
+  std::atomic<size_t> next_task(0);
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; t++) {
+    workers.emplace_back([&, t]() {
+      MoveGenerator &gen = *generators[t];
+      size_t k;
+      while ((k = next_task++) < tasks.size()) {
+        const Move root_move = move_list.at(tasks[k].first);
+        const Move reply = tasks[k].second;
+        gen.pos->make_move(root_move);
+        gen.pos->make_move(reply);
+        counts[tasks[k].first] += gen.perft(depth - 2);
+        gen.pos->undo_move(reply);
+        gen.pos->undo_move(root_move);
+      }
+    });
   }
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
 
+// Bulk counting (https://www.chessprogramming.org/Perft#Bulk-counting)
+// Since the generator only emits legal moves, the leaves one ply from the
+// horizon are counted straight off the move list instead of being made.
+// Subtrees of depth 2+ are cached in Utils::PERFT_TT (always-replace). The
+// table is shared between divide threads, so the stored key is XORed with
+// the data and a torn entry simply fails to match.
+uint64_t MoveGenerator::perft(const size_t depth) {
   if (depth == 0) {
     return 1ULL;
   }
 
-  move_list = generate_pseudo_legal_moves();
+  const zobrist_key key = pos->z_key;
+  const bool use_hash = (depth > 1) && !Utils::PERFT_TT.empty();
+  Perft_Entry *entry = nullptr;
+  if (use_hash) {
+    entry = &Utils::PERFT_TT[key % Utils::PERFT_TT.size()];
+    Perft_Entry hit = *entry;
+    if (((hit.key ^ hit.nodes ^ hit.depth) == key) && (hit.depth == depth)) {
+      return hit.nodes;
+    }
+  }
+
+  MoveList move_list = generate_legal_moves();
+  if (depth == 1) {
+    return move_list.size();
+  }
 
+  uint64_t nodes = 0;
   for (size_t i = 0; i < move_list.size(); i++) {
     pos->make_move(move_list.at(i));
-    if (!validate_gamestate()) {
-      pos->undo_move(move_list.at(i));
-      continue;
-    }
     nodes += perft(depth - 1);
     pos->undo_move(move_list.at(i));
   }
+
+  if (use_hash) {
+    *entry = Perft_Entry(key ^ nodes ^ depth, depth, nodes);
+  }
   return nodes;
 }
 
-bool MoveGenerator::validate_gamestate() const {
-  return !king_in_check(~pos->side_to_play);
-}
 bool MoveGenerator::king_in_check(const Colors side) const {
   bitboard king_bb = pos->get_bitboard(side, Pieces::KING);
   Square king_square = Utils::pop_bit(king_bb);
   return generate_attackers(king_square) & pos->color_bitboards[~side];
 }
 
-int MoveGenerator::generate_rank_attack(int occupancy, size_t file) const {
-  int b;
-  int x;
-  int y = 0;
-  for (int x = file - 1; x >= 0; x--) {
-    b = 1 << x;
-    y |= b;
-    if ((occupancy & b) == b)
-      break;
-  }
-  for (x = file + 1; x < 8; x++) {
-    b = 1 << x;
-    y |= b;
-    if ((occupancy & b) == b)
-      break;
-  }
-  return y;
-}
-
-void MoveGenerator::initiate_rank_attacks() {
-  for (size_t x = 0; x < NSQUARES; x++) {
-    for (size_t file = 0; file < 8; file++) {
-      RANK_ATTACKS[x * 8ULL + file] = generate_rank_attack(x * 2, file);
-    }
-  }
+bitboard MoveGenerator::generate_attackers(const Square sq) const {
+  return generate_attackers(sq, pos->get_occupied());
 }
 
-bitboard MoveGenerator::generate_attackers(const Square sq) const {
+// Attackers of both colors on sq with sliders blocked by occupancy, pieces
+// removed from occupancy are still returned and must be masked by the caller
+bitboard MoveGenerator::generate_attackers(const Square sq,
+                                           const bitboard occupancy) const {
   bitboard wpawn_bb = pos->get_bitboard(Colors::WHITE, Pieces::PAWN);
   bitboard bpawn_bb = pos->get_bitboard(Colors::BLACK, Pieces::PAWN);
   bitboard knights_bb = pos->pieces_bitboards[Pieces::KNIGHT];
@@ -122,8 +272,8 @@ bitboard MoveGenerator::generate_attackers(const Square sq) const {
   bitboard queens_bb = pos->pieces_bitboards[Pieces::QUEEN];
   bitboard kings_bb = pos->pieces_bitboards[Pieces::KING];
 
-  bitboard rect_attacks = generate_rectilinear_attacks(pos->get_occupied(), sq);
-  bitboard diag_attacks = generate_diagonal_attacks(pos->get_occupied(), sq);
+  bitboard rect_attacks = AttackTables::rook_attacks(sq, occupancy);
+  bitboard diag_attacks = AttackTables::bishop_attacks(sq, occupancy);
 
   return ((AttackTables::W_PAWN.ATTACKS[sq] & bpawn_bb) |
           (AttackTables::B_PAWN.ATTACKS[sq] & wpawn_bb) |
@@ -133,93 +283,362 @@ bitboard MoveGenerator::generate_attackers(const Square sq) const {
           ((diag_attacks | rect_attacks) & queens_bb));
 }
 
-bitboard MoveGenerator::generate_pinned_pieces() {
+// Pieces of the side to play that shield the enemy king from one of their
+// own sliders, moving one off that line gives a discovered check
+bitboard MoveGenerator::discovered_check_candidates() const {
+  const Colors us = pos->side_to_play;
+  const bitboard own = pos->color_bitboards[us];
+  const bitboard queens = pos->get_bitboard(us, Pieces::QUEEN);
+  const Square enemy_king = Utils::lsb(pos->get_bitboard(~us, Pieces::KING));
+
+  bitboard snipers =
+      xray_rectilinear_attacks(pos->get_occupied(), own, enemy_king) &
+      (pos->get_bitboard(us, Pieces::ROOK) | queens);
+  snipers |= xray_diagonal_attacks(pos->get_occupied(), own, enemy_king) &
+             (pos->get_bitboard(us, Pieces::BISHOP) | queens);
+
+  bitboard candidates = 0ULL;
+  while (snipers) {
+    Square sq = Utils::pop_bit(snipers);
+    candidates |= Utils::IN_BETWEEN[sq][enemy_king] & own;
+  }
+  return candidates;
+}
+
+// Whether mv checks the enemy king, without making it. Direct checks come
+// from the moved (or promoted) piece on its to-square, discovered ones from
+// a candidate leaving its line to the king. Castling and en passant are
+// rare and reported as checks, so callers stay on the safe side.
+bool MoveGenerator::gives_check(const Move mv,
+                                const bitboard discoverers) const {
+  if (mv.is_castle() || mv.is_en_passant()) {
+    return true;
+  }
+
+  const Colors us = pos->side_to_play;
+  const bitboard enemy_king_bb = pos->get_bitboard(~us, Pieces::KING);
+  const Square enemy_king = Utils::lsb(enemy_king_bb);
+  const Square from = mv.from();
+  const Square to = mv.to();
+  const bitboard occupancy =
+      (pos->get_occupied() ^ Utils::set_bit(from)) | Utils::set_bit(to);
+
+  bitboard attacks = 0ULL;
+  switch (mv.is_promotion() ? mv.promotion() : pos->board[from]) {
+  case PAWN:
+    attacks = (us == WHITE) ? AttackTables::W_PAWN.ATTACKS[to]
+                            : AttackTables::B_PAWN.ATTACKS[to];
+    break;
+  case KNIGHT:
+    attacks = AttackTables::KNIGHT.ATTACKS[to];
+    break;
+  case BISHOP:
+    attacks = AttackTables::bishop_attacks(to, occupancy);
+    break;
+  case ROOK:
+    attacks = AttackTables::rook_attacks(to, occupancy);
+    break;
+  case QUEEN:
+    attacks = AttackTables::queen_attacks(to, occupancy);
+    break;
+  default:
+    break;
+  }
+  if (attacks & enemy_king_bb) {
+    return true;
+  }
+
+  return (discoverers & Utils::set_bit(from)) &&
+         !(Utils::LINE[enemy_king][from] & Utils::set_bit(to));
+}
+
+// Static Exchange Evaluation
+// (https://www.chessprogramming.org/SEE_-_The_Swap_Algorithm)
+// Material balance of the exchange sequence started by mv on its to-square,
+// each side recapturing with its least valuable attacker and free to stop.
+// Sliders uncovered behind a capturing piece join in (x-rays). Pins are
+// ignored and a promotion is scored as a plain pawn move.
+int MoveGenerator::see(const Move mv) const {
+  if (mv.is_castle()) {
+    return 0;
+  }
+
+  const Square to = mv.to();
+  bitboard occupancy = pos->get_occupied();
+  if (mv.is_en_passant()) {
+    occupancy ^= Utils::set_bit(
+        Utils::get_square(Utils::rank(mv.from()), Utils::file(to)));
+  }
+  const bitboard diagonal_sliders =
+      pos->pieces_bitboards[BISHOP] | pos->pieces_bitboards[QUEEN];
+  const bitboard rectilinear_sliders =
+      pos->pieces_bitboards[ROOK] | pos->pieces_bitboards[QUEEN];
+
+  // gain[d] is the balance for the side making the d-th capture, at most
+  // 32 pieces take part
+  int gain[33];
+  size_t d = 0;
+  gain[0] = mv.is_capture() ? SEE_VALUE[pos->get_captured_piece(mv)] : 0;
+
+  Colors side = pos->side_to_play;
+  Pieces attacker = pos->board[mv.from()];
+  bitboard from_bb = Utils::set_bit(mv.from());
+  bitboard attackers = generate_attackers(to, occupancy);
+
+  while (from_bb) {
+    d++;
+    // Speculative: the balance if the piece that just captured is taken
+    gain[d] = SEE_VALUE[attacker] - gain[d - 1];
+
+    // Remove the capturing piece and uncover any slider behind it
+    occupancy ^= from_bb;
+    attackers |=
+        (AttackTables::bishop_attacks(to, occupancy) & diagonal_sliders) |
+        (AttackTables::rook_attacks(to, occupancy) & rectilinear_sliders);
+    attackers &= occupancy;
+
+    // Recapture with the least valuable piece
+    side = ~side;
+    from_bb = 0ULL;
+    bitboard side_attackers = attackers & pos->color_bitboards[side];
+    for (int pc = PAWN; side_attackers && (pc <= KING); pc++) {
+      bitboard candidates = side_attackers & pos->pieces_bitboards[pc];
+      if (candidates) {
+        attacker = static_cast<Pieces>(pc);
+        from_bb = Utils::set_bit(Utils::lsb(candidates));
+        break;
+      }
+    }
+  }
+
+  while (--d) {
+    gain[d - 1] = -std::max(-gain[d - 1], gain[d]);
+  }
+  return gain[0];
+}
+
+// Whether mv wins at least threshold, skipping the exchange when the first
+// capture alone decides it
+bool MoveGenerator::see_ge(const Move mv, const int threshold) const {
+  if (mv.is_castle()) {
+    return 0 >= threshold;
+  }
+  int captured = mv.is_capture() ? SEE_VALUE[pos->get_captured_piece(mv)] : 0;
+  // Losing nothing is not enough
+  if (captured < threshold) {
+    return false;
+  }
+  // Even losing the capturing piece is enough
+  if (captured - SEE_VALUE[pos->board[mv.from()]] >= threshold) {
+    return true;
+  }
+  return see(mv) >= threshold;
+}
+
+// Pieces of the side to play that shield their king from an enemy slider
+bitboard MoveGenerator::generate_pinned_pieces() const {
   bitboard pinned = 0ULL;
-  bitboard king = pos->get_bitboard(Pieces::KING);
+  bitboard own = pos->color_bitboards[pos->side_to_play];
   bitboard opp_rooks = pos->get_bitboard(~pos->side_to_play, Pieces::ROOK);
   bitboard opp_queens = pos->get_bitboard(~pos->side_to_play, Pieces::QUEEN);
-  bitboard opp_rect_attackers = opp_rooks | opp_queens;
+  bitboard opp_bishops = pos->get_bitboard(~pos->side_to_play, Pieces::BISHOP);
 
-  bitboard pinners = xray_rectilinear_attacks(
-      pos->get_occupied(), pos->color_bitboards[pos->side_to_play],
-      Utils::pop_bit(king));
-  pinners &= opp_rect_attackers;
-  while (pinners) {
-    Square sq = Utils::pop_bit(pinners);
-    pinned |= Utils::IN_BETWEEN[sq][Utils::pop_bit(king)] &
-              pos->color_bitboards[pos->side_to_play];
-  }
+  bitboard pinners =
+      xray_rectilinear_attacks(pos->get_occupied(), own, king_square) &
+      (opp_rooks | opp_queens);
+  pinners |= xray_diagonal_attacks(pos->get_occupied(), own, king_square) &
+             (opp_bishops | opp_queens);
 
-  bitboard opp_bishops = pos->get_bitboard(~pos->side_to_play, Pieces::BISHOP);
-  bitboard opp_diag_attackers = opp_queens | opp_bishops;
-  pinners = xray_diagonal_attacks(pos->get_occupied(),
-                                  pos->color_bitboards[pos->side_to_play],
-                                  Utils::pop_bit(king));
-  pinners &= opp_diag_attackers;
   while (pinners) {
     Square sq = Utils::pop_bit(pinners);
-    pinned |= Utils::IN_BETWEEN[sq][Utils::pop_bit(king)] &
-              pos->color_bitboards[pos->side_to_play];
+    pinned |= Utils::IN_BETWEEN[sq][king_square] & own;
   }
   return pinned;
 }
 
-MoveList MoveGenerator::generate_pseudo_legal_moves() {
-  MoveList pseudo_legal_moves = MoveList();
+// Every square attacked by the enemy, with our king lifted off the board so
+// it cannot step backwards along the ray of a slider that checks it
+bitboard MoveGenerator::generate_king_danger() const {
+  Colors enemy = ~pos->side_to_play;
+  bitboard occupancy = pos->get_occupied() ^ Utils::set_bit(king_square);
+  const auto &pawn_attack_table = (enemy == WHITE)
+                                      ? AttackTables::W_PAWN.ATTACKS
+                                      : AttackTables::B_PAWN.ATTACKS;
+  bitboard danger = 0ULL;
+
+  bitboard pawns = pos->get_bitboard(enemy, Pieces::PAWN);
+  while (pawns) {
+    danger |= pawn_attack_table[Utils::pop_bit(pawns)];
+  }
+  bitboard knights = pos->get_bitboard(enemy, Pieces::KNIGHT);
+  while (knights) {
+    danger |= AttackTables::KNIGHT.ATTACKS[Utils::pop_bit(knights)];
+  }
+  bitboard queens = pos->get_bitboard(enemy, Pieces::QUEEN);
+  bitboard diagonals = pos->get_bitboard(enemy, Pieces::BISHOP) | queens;
+  while (diagonals) {
+    danger |=
+        AttackTables::bishop_attacks(Utils::pop_bit(diagonals), occupancy);
+  }
+  bitboard rectilinears = pos->get_bitboard(enemy, Pieces::ROOK) | queens;
+  while (rectilinears) {
+    danger |=
+        AttackTables::rook_attacks(Utils::pop_bit(rectilinears), occupancy);
+  }
+  danger |= AttackTables::KING.ATTACKS[Utils::lsb(
+      pos->get_bitboard(enemy, Pieces::KING))];
 
-  bitboard pawn_bb = pos->get_bitboard(Pieces::PAWN);
-  bitboard knight_bb = pos->get_bitboard(Pieces::KNIGHT);
-  bitboard bishop_bb = pos->get_bitboard(Pieces::BISHOP);
-  bitboard rook_bb = pos->get_bitboard(Pieces::ROOK);
-  bitboard queen_bb = pos->get_bitboard(Pieces::QUEEN);
-  bitboard king_bb = pos->get_bitboard(Pieces::KING);
+  return danger;
+}
 
-  generate_pawn_moves(pseudo_legal_moves, pawn_bb);
-  generate_knight_moves(pseudo_legal_moves, knight_bb);
-  generate_king_moves(pseudo_legal_moves, king_bb);
-  generate_bishop_moves(pseudo_legal_moves, bishop_bb);
-  generate_rook_moves(pseudo_legal_moves, rook_bb);
-  generate_queen_moves(pseudo_legal_moves, queen_bb);
+// Computes the checker, pin and king-danger masks the generators filter by
+// (https://peterellisjones.com/posts/generating-legal-chess-moves-efficiently/)
+// Masks are cached per position key, so a node that generates in stages or
+// validates hash moves only pays for them once
+void MoveGenerator::update_legality_masks() {
+  if (masks_key == pos->z_key) {
+    return;
+  }
+  masks_key = pos->z_key;
+
+  king_square = Utils::lsb(pos->get_bitboard(Pieces::KING));
+  checkers = generate_attackers(king_square) & pos->get_enemy();
+  pinned = generate_pinned_pieces();
+  king_danger = generate_king_danger();
+
+  // In check, non-king moves must capture the checker or block its ray,
+  // and in double check only the king may move
+  if (checkers == 0ULL) {
+    check_mask = ~0ULL;
+  } else if (Utils::pop_count(checkers) == 1) {
+    Square checker_square = Utils::lsb(checkers);
+    check_mask = checkers | Utils::IN_BETWEEN[king_square][checker_square];
+  } else {
+    check_mask = 0ULL;
+  }
+}
 
-  return pseudo_legal_moves;
+// En passant removes two pieces from one rank, which can expose the king in
+// ways the pin masks miss, so it is verified on the resulting occupancy
+bool MoveGenerator::is_legal_en_passant(const Square origin,
+                                        const Square destination) const {
+  Colors enemy = ~pos->side_to_play;
+  Square captured_square = (pos->side_to_play == WHITE)
+                               ? (Square)(destination + S)
+                               : (Square)(destination + N);
+  bitboard occupancy = pos->get_occupied() ^ Utils::set_bit(origin) ^
+                       Utils::set_bit(captured_square) ^
+                       Utils::set_bit(destination);
+  const auto &pawn_attack_table = (pos->side_to_play == WHITE)
+                                      ? AttackTables::W_PAWN.ATTACKS
+                                      : AttackTables::B_PAWN.ATTACKS;
+
+  bitboard queens = pos->get_bitboard(enemy, Pieces::QUEEN);
+  bitboard attackers =
+      (AttackTables::rook_attacks(king_square, occupancy) &
+       (pos->get_bitboard(enemy, Pieces::ROOK) | queens)) |
+      (AttackTables::bishop_attacks(king_square, occupancy) &
+       (pos->get_bitboard(enemy, Pieces::BISHOP) | queens)) |
+      (AttackTables::KNIGHT.ATTACKS[king_square] &
+       pos->get_bitboard(enemy, Pieces::KNIGHT)) |
+      (pawn_attack_table[king_square] &
+       pos->get_bitboard(enemy, Pieces::PAWN) &
+       ~Utils::set_bit(captured_square));
+  return attackers == 0ULL;
+}
+
+MoveList MoveGenerator::generate_legal_moves() {
+  MoveList legal_moves = MoveList();
+  generate<ALL>(legal_moves);
+  return legal_moves;
 }
 
 MoveList MoveGenerator::generate_captures() {
   MoveList captures = MoveList();
+  generate<CAPTURES>(captures);
+  return captures;
+}
+
+MoveList MoveGenerator::generate_quiets() {
+  MoveList quiets = MoveList();
+  generate<QUIETS>(quiets);
+  return quiets;
+}
+
+// Checks a move (e.g. a hash or killer move) by generating only the moves
+// of the piece on its origin square
+bool MoveGenerator::is_legal(const Move mv) {
+  bitboard origin_bb = Utils::set_bit(mv.from());
+  if (!(origin_bb & pos->color_bitboards[pos->side_to_play])) {
+    return false;
+  }
+  update_legality_masks();
+
+  MoveList moves = MoveList();
+  switch (pos->board[mv.from()]) {
+  case PAWN:
+    generate_pawn_moves<ALL>(moves, origin_bb);
+    break;
+  case KNIGHT:
+    generate_knight_moves<ALL>(moves, origin_bb);
+    break;
+  case BISHOP:
+    generate_bishop_moves<ALL>(moves, origin_bb);
+    break;
+  case ROOK:
+    generate_rook_moves<ALL>(moves, origin_bb);
+    break;
+  case QUEEN:
+    generate_queen_moves<ALL>(moves, origin_bb);
+    break;
+  case KING:
+    generate_king_moves<ALL>(moves, origin_bb);
+    break;
+  default:
+    return false;
+  }
+
+  for (size_t i = 0; i < moves.size(); i++) {
+    if (moves.at(i) == mv) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template <GenType type> void MoveGenerator::generate(MoveList &move_list) {
+  update_legality_masks();
+
+  bitboard king_bb = pos->get_bitboard(Pieces::KING);
+  generate_king_moves<type>(move_list, king_bb);
+  if (check_mask == 0ULL) {
+    return;
+  }
 
   bitboard pawn_bb = pos->get_bitboard(Pieces::PAWN);
   bitboard knight_bb = pos->get_bitboard(Pieces::KNIGHT);
   bitboard bishop_bb = pos->get_bitboard(Pieces::BISHOP);
   bitboard rook_bb = pos->get_bitboard(Pieces::ROOK);
   bitboard queen_bb = pos->get_bitboard(Pieces::QUEEN);
-  bitboard king_bb = pos->get_bitboard(Pieces::KING);
-
-  generate_pawn_captures(captures, pawn_bb);
-  generate_knight_captures(captures, knight_bb);
-  generate_king_captures(captures, king_bb);
-  generate_bishop_captures(captures, bishop_bb);
-  generate_rook_captures(captures, rook_bb);
-  generate_queen_captures(captures, queen_bb);
 
-  return captures;
+  generate_pawn_moves<type>(move_list, pawn_bb);
+  generate_knight_moves<type>(move_list, knight_bb);
+  generate_bishop_moves<type>(move_list, bishop_bb);
+  generate_rook_moves<type>(move_list, rook_bb);
+  generate_queen_moves<type>(move_list, queen_bb);
 }
 
-MoveList MoveGenerator::generate_legal_moves() {
-  MoveList ps = generate_pseudo_legal_moves();
-  MoveList l = MoveList();
-  for (size_t i = 0; i < ps.size(); i++) {
-    pos->make_move(ps.at(i));
-    if (!king_in_check(~pos->side_to_play)) {
-      l.push_back(ps.at(i));
-    }
-    pos->undo_move(ps.at(i));
+template <GenType type>
+void MoveGenerator::generate_pawn_moves(MoveList &move_list, bitboard bb) {
+  if (type != CAPTURES) {
+    generate_pawn_pushes(move_list, bb);
+  }
+  if (type != QUIETS) {
+    generate_pawn_captures(move_list, bb);
   }
-  return l;
 }
 
-void MoveGenerator::generate_pawn_moves(MoveList &move_list, bitboard bb) {
-
-  Pieces promotion_pieces[4] = {QUEEN, KNIGHT, ROOK, BISHOP};
+void MoveGenerator::generate_pawn_pushes(MoveList &move_list, bitboard bb) {
   if (pos->side_to_play == WHITE) {
     bitboard single_pawn_push = bb << N;
     single_pawn_push &= ~pos->get_occupied();
@@ -229,73 +648,22 @@ void MoveGenerator::generate_pawn_moves(MoveList &move_list, bitboard bb) {
       double_pawn_push &= ~pos->get_occupied();
     }
 
-    // pops each pawn and adds its move to the list of pseudo-legal moves
+    // pops each pawn and adds its move to the list of legal moves
     while (single_pawn_push > 0) {
-      Move psudeo_legal_move = {};
-      psudeo_legal_move.piece = Pieces::PAWN;
-      psudeo_legal_move.to = Utils::pop_bit(single_pawn_push);
-      psudeo_legal_move.from = (Square)(psudeo_legal_move.to + S);
-
-      if (Utils::rank(psudeo_legal_move.to) == 7) {
-        for (const auto &promotion_piece : promotion_pieces) {
-          psudeo_legal_move.promotion = promotion_piece;
-          move_list.push_back(psudeo_legal_move);
-        }
-      } else {
-        move_list.push_back(psudeo_legal_move);
+      Square destination_square = Utils::pop_bit(single_pawn_push);
+      Square origin_square = (Square)(destination_square + S);
+      if (legal_targets(origin_square) & Utils::set_bit(destination_square)) {
+        add_pawn_move(move_list, origin_square, destination_square, QUIET);
       }
     }
 
-    // pops each pawn and adds its move to the list of pseudo-legal moves
+    // pops each pawn and adds its move to the list of legal moves
     while (double_pawn_push > 0) {
-      Move psudeo_legal_move = {};
-      psudeo_legal_move.piece = Pieces::PAWN;
-      psudeo_legal_move.to = Utils::pop_bit(double_pawn_push);
-      psudeo_legal_move.from = (Square)(psudeo_legal_move.to + S + S);
-      psudeo_legal_move.is_double_push = true;
-
-      move_list.push_back(psudeo_legal_move);
-    }
-
-    bitboard origin_bb = bb;
-    while (origin_bb) {
-      Square origin_square = Utils::pop_bit(origin_bb);
-      bitboard pawn_attacks = AttackTables::W_PAWN.ATTACKS[origin_square];
-      bitboard capture_moves_bb = pawn_attacks & pos->get_enemy();
-      while (capture_moves_bb) {
-        Square destination_square = Utils::pop_bit(capture_moves_bb);
-        Move capture = {};
-        capture.piece = PAWN;
-        capture.from = origin_square;
-        capture.to = destination_square;
-        capture.is_capture = true;
-        capture.captured_piece = get_piece_type(capture.to);
-        if (Utils::rank(capture.to) == 7) {
-          for (const auto &promotion_piece : promotion_pieces) {
-            capture.promotion = promotion_piece;
-            move_list.push_back(capture);
-          }
-        } else {
-          move_list.push_back(capture);
-        }
-      }
-
-      add_capture_moves(move_list, capture_moves_bb, Pieces::PAWN,
-                        origin_square);
-      if (pos->en_passant_square > 0) {
-        bitboard en_passant_moves_bb =
-            pawn_attacks & Utils::set_bit(pos->en_passant_square);
-        while (en_passant_moves_bb) {
-          Square destination_square = Utils::pop_bit(en_passant_moves_bb);
-          Move en_passant = {};
-          en_passant.piece = PAWN;
-          en_passant.from = origin_square;
-          en_passant.to = destination_square;
-          en_passant.is_capture = true;
-          en_passant.is_en_passant = true;
-          en_passant.captured_piece = PAWN;
-          move_list.push_back(en_passant);
-        }
+      Square destination_square = Utils::pop_bit(double_pawn_push);
+      Square origin_square = (Square)(destination_square + S + S);
+      if (legal_targets(origin_square) & Utils::set_bit(destination_square)) {
+        move_list.push_back(
+            Move(origin_square, destination_square, DOUBLE_PUSH));
       }
     }
 
@@ -309,436 +677,133 @@ void MoveGenerator::generate_pawn_moves(MoveList &move_list, bitboard bb) {
       double_pawn_push &= ~pos->get_occupied();
     }
 
-    // pops each pawn and adds its move to the list of pseudo-legal moves
+    // pops each pawn and adds its move to the list of legal moves
     while (single_pawn_push != 0ULL) {
-      Move psudeo_legal_move = {};
-      psudeo_legal_move.piece = Pieces::PAWN;
-      psudeo_legal_move.to = Utils::pop_bit(single_pawn_push);
-      psudeo_legal_move.from = (Square)(psudeo_legal_move.to + N);
-      if (Utils::rank(psudeo_legal_move.to) == 0) {
-        for (const auto &promotion_piece : promotion_pieces) {
-          psudeo_legal_move.promotion = promotion_piece;
-          move_list.push_back(psudeo_legal_move);
-        }
-      } else {
-        move_list.push_back(psudeo_legal_move);
+      Square destination_square = Utils::pop_bit(single_pawn_push);
+      Square origin_square = (Square)(destination_square + N);
+      if (legal_targets(origin_square) & Utils::set_bit(destination_square)) {
+        add_pawn_move(move_list, origin_square, destination_square, QUIET);
       }
     }
 
-    // pops each pawn and adds its move to the list of pseudo-legal moves
+    // pops each pawn and adds its move to the list of legal moves
     while (double_pawn_push > 0) {
-      Move psudeo_legal_move = {};
-      psudeo_legal_move.piece = Pieces::PAWN;
-      psudeo_legal_move.to = Utils::pop_bit(double_pawn_push);
-      psudeo_legal_move.from = (Square)(psudeo_legal_move.to + N + N);
-      psudeo_legal_move.is_double_push = true;
-      move_list.push_back(psudeo_legal_move);
-    }
-
-    bitboard origin_bb = bb;
-    while (origin_bb) {
-      Square origin_square = Utils::pop_bit(origin_bb);
-      bitboard pawn_attacks = AttackTables::B_PAWN.ATTACKS[origin_square];
-      if (pawn_attacks) {
-      };
-
-      bitboard capture_moves_bb = pawn_attacks & pos->get_enemy();
-      while (capture_moves_bb) {
-        Square destination_square = Utils::pop_bit(capture_moves_bb);
-        Move capture = {};
-        capture.piece = PAWN;
-        capture.from = origin_square;
-        capture.to = destination_square;
-        capture.is_capture = true;
-        capture.captured_piece = get_piece_type(capture.to);
-
-        if (Utils::rank(capture.to) == 0) {
-          for (const auto &promotion_piece : promotion_pieces) {
-            capture.promotion = promotion_piece;
-            move_list.push_back(capture);
-          }
-        } else {
-          move_list.push_back(capture);
-        }
-      }
-      if (pos->en_passant_square > 0) {
-        bitboard en_passant_moves_bb =
-            pawn_attacks & Utils::set_bit(pos->en_passant_square);
-        while (en_passant_moves_bb) {
-          Square destination_square = Utils::pop_bit(en_passant_moves_bb);
-          Move en_passant = {};
-          en_passant.piece = PAWN;
-          en_passant.from = origin_square;
-          en_passant.to = destination_square;
-          en_passant.is_capture = true;
-          en_passant.is_en_passant = true;
-          en_passant.captured_piece = PAWN;
-          move_list.push_back(en_passant);
-        }
+      Square destination_square = Utils::pop_bit(double_pawn_push);
+      Square origin_square = (Square)(destination_square + N + N);
+      if (legal_targets(origin_square) & Utils::set_bit(destination_square)) {
+        move_list.push_back(
+            Move(origin_square, destination_square, DOUBLE_PUSH));
       }
     }
   }
 }
 
 void MoveGenerator::generate_pawn_captures(MoveList &move_list, bitboard bb) {
-  Pieces promotion_pieces[4] = {QUEEN, KNIGHT, ROOK, BISHOP};
-  if (pos->side_to_play == WHITE) {
-    bitboard origin_bb = bb;
-    while (origin_bb) {
-      Square origin_square = Utils::pop_bit(origin_bb);
-      bitboard pawn_attacks = AttackTables::W_PAWN.ATTACKS[origin_square];
-      bitboard capture_moves_bb = pawn_attacks & pos->get_enemy();
-      while (capture_moves_bb) {
-        Square destination_square = Utils::pop_bit(capture_moves_bb);
-        Move capture = {};
-        capture.piece = PAWN;
-        capture.from = origin_square;
-        capture.to = destination_square;
-        capture.is_capture = true;
-        capture.captured_piece = get_piece_type(capture.to);
-        if (Utils::rank(capture.to) == 7) {
-          for (const auto &promotion_piece : promotion_pieces) {
-            capture.promotion = promotion_piece;
-            move_list.push_back(capture);
-          }
-        } else {
-          move_list.push_back(capture);
-        }
-      }
-
-      add_capture_moves(move_list, capture_moves_bb, Pieces::PAWN,
-                        origin_square);
-      if (pos->en_passant_square > 0) {
-        bitboard en_passant_moves_bb =
-            pawn_attacks & Utils::set_bit(pos->en_passant_square);
-        while (en_passant_moves_bb) {
-          Square destination_square = Utils::pop_bit(en_passant_moves_bb);
-          Move en_passant = {};
-          en_passant.piece = PAWN;
-          en_passant.from = origin_square;
-          en_passant.to = destination_square;
-          en_passant.is_capture = true;
-          en_passant.is_en_passant = true;
-          en_passant.captured_piece = PAWN;
-          move_list.push_back(en_passant);
-        }
-      }
+  const auto &pawn_attack_table = (pos->side_to_play == WHITE)
+                                      ? AttackTables::W_PAWN.ATTACKS
+                                      : AttackTables::B_PAWN.ATTACKS;
+  bitboard origin_bb = bb;
+  while (origin_bb) {
+    Square origin_square = Utils::pop_bit(origin_bb);
+    bitboard pawn_attacks = pawn_attack_table[origin_square];
+    bitboard capture_moves_bb =
+        pawn_attacks & pos->get_enemy() & legal_targets(origin_square);
+    while (capture_moves_bb) {
+      Square destination_square = Utils::pop_bit(capture_moves_bb);
+      add_pawn_move(move_list, origin_square, destination_square, CAPTURE);
     }
-  } else if (pos->side_to_play == BLACK) {
-    bitboard origin_bb = bb;
-    while (origin_bb) {
-      Square origin_square = Utils::pop_bit(origin_bb);
-      bitboard pawn_attacks = AttackTables::B_PAWN.ATTACKS[origin_square];
-      bitboard capture_moves_bb = pawn_attacks & pos->get_enemy();
-      while (capture_moves_bb) {
-        Square destination_square = Utils::pop_bit(capture_moves_bb);
-        Move capture = {};
-        capture.piece = PAWN;
-        capture.from = origin_square;
-        capture.to = destination_square;
-        capture.is_capture = true;
-        capture.captured_piece = get_piece_type(capture.to);
-
-        if (Utils::rank(capture.to) == 0) {
-          for (const auto &promotion_piece : promotion_pieces) {
-            capture.promotion = promotion_piece;
-            move_list.push_back(capture);
-          }
-        } else {
-          move_list.push_back(capture);
-        }
-      }
-      if (pos->en_passant_square > 0) {
-        bitboard en_passant_moves_bb =
-            pawn_attacks & Utils::set_bit(pos->en_passant_square);
-        while (en_passant_moves_bb) {
-          Square destination_square = Utils::pop_bit(en_passant_moves_bb);
-          Move en_passant = {};
-          en_passant.piece = PAWN;
-          en_passant.from = origin_square;
-          en_passant.to = destination_square;
-          en_passant.is_capture = true;
-          en_passant.is_en_passant = true;
-          en_passant.captured_piece = PAWN;
-          move_list.push_back(en_passant);
+
+    if (pos->en_passant_square > 0) {
+      bitboard en_passant_moves_bb =
+          pawn_attacks & Utils::set_bit(pos->en_passant_square);
+      while (en_passant_moves_bb) {
+        Square destination_square = Utils::pop_bit(en_passant_moves_bb);
+        if (is_legal_en_passant(origin_square, destination_square)) {
+          move_list.push_back(
+              Move(origin_square, destination_square, EN_PASSANT));
         }
       }
     }
   }
 }
 
+template <GenType type>
 void MoveGenerator::generate_knight_moves(MoveList &move_list, bitboard bb) {
-
-  while (bb) {
-    Square origin_square = Utils::pop_bit(bb);
-    bitboard knight_moves = AttackTables::KNIGHT.ATTACKS[origin_square];
-
-    bitboard quiet_moves_bb = knight_moves & pos->get_empty();
-    bitboard capture_moves_bb = knight_moves & pos->get_enemy();
-
-    add_quiet_moves(move_list, quiet_moves_bb, Pieces::KNIGHT, origin_square);
-    add_capture_moves(move_list, capture_moves_bb, Pieces::KNIGHT,
-                      origin_square);
-  }
-}
-
-void MoveGenerator::generate_knight_captures(MoveList &move_list, bitboard bb) {
-
   while (bb) {
     Square origin_square = Utils::pop_bit(bb);
-    bitboard knight_moves = AttackTables::KNIGHT.ATTACKS[origin_square];
-
-    bitboard capture_moves_bb = knight_moves & pos->get_enemy();
-    add_capture_moves(move_list, capture_moves_bb, Pieces::KNIGHT,
-                      origin_square);
+    bitboard knight_moves = AttackTables::KNIGHT.ATTACKS[origin_square] &
+                            legal_targets(origin_square);
+    add_moves<type>(move_list, knight_moves, origin_square);
   }
 }
 
+template <GenType type>
 void MoveGenerator::generate_king_moves(MoveList &move_list, bitboard bb) {
   Square origin_square = Utils::pop_bit(bb);
-  bitboard king_moves = AttackTables::KING.ATTACKS[origin_square];
-
-  bitboard quiet_moves_bb = king_moves & pos->get_empty();
-  bitboard capture_moves_bb = king_moves & pos->get_enemy();
+  bitboard king_moves =
+      AttackTables::KING.ATTACKS[origin_square] & ~king_danger;
 
-  add_castling_moves(move_list);
-  add_quiet_moves(move_list, quiet_moves_bb, Pieces::KING, origin_square);
-  add_capture_moves(move_list, capture_moves_bb, Pieces::KING, origin_square);
+  if (type != CAPTURES) {
+    add_castling_moves(move_list);
+  }
+  add_moves<type>(move_list, king_moves, origin_square);
 }
 
-void MoveGenerator::generate_king_captures(MoveList &move_list, bitboard bb) {
-  Square origin_square = Utils::pop_bit(bb);
-  bitboard king_moves = AttackTables::KING.ATTACKS[origin_square];
-
-  bitboard capture_moves_bb = king_moves & pos->get_enemy();
-
-  add_capture_moves(move_list, capture_moves_bb, Pieces::KING, origin_square);
-}
+template <GenType type>
 void MoveGenerator::generate_rook_moves(MoveList &move_list, bitboard bb) {
   while (bb) {
     Square origin_square = Utils::pop_bit(bb);
     bitboard occupancy = pos->get_occupied();
-    bitboard rook_moves =
-        generate_rectilinear_attacks(occupancy, origin_square);
-
-    bitboard quiet_moves_bb = rook_moves & pos->get_empty();
-    bitboard capture_moves_bb = rook_moves & pos->get_enemy();
-
-    add_quiet_moves(move_list, quiet_moves_bb, Pieces::ROOK, origin_square);
-    add_capture_moves(move_list, capture_moves_bb, Pieces::ROOK, origin_square);
+    bitboard rook_moves = AttackTables::rook_attacks(origin_square, occupancy) &
+                          legal_targets(origin_square);
+    add_moves<type>(move_list, rook_moves, origin_square);
   }
 }
 
-void MoveGenerator::generate_rook_captures(MoveList &move_list, bitboard bb) {
-  while (bb) {
-    Square origin_square = Utils::pop_bit(bb);
-    bitboard occupancy = pos->get_occupied();
-    bitboard rook_moves =
-        generate_rectilinear_attacks(occupancy, origin_square);
-
-    bitboard capture_moves_bb = rook_moves & pos->get_enemy();
-
-    add_capture_moves(move_list, capture_moves_bb, Pieces::ROOK, origin_square);
-  }
-}
+template <GenType type>
 void MoveGenerator::generate_bishop_moves(MoveList &move_list, bitboard bb) {
   while (bb) {
     Square origin_square = Utils::pop_bit(bb);
     bitboard occupancy = pos->get_occupied();
-    bitboard bishop_moves = generate_diagonal_attacks(occupancy, origin_square);
-
-    bitboard quiet_moves_bb = bishop_moves & pos->get_empty();
-    bitboard capture_moves_bb = bishop_moves & pos->get_enemy();
-
-    add_quiet_moves(move_list, quiet_moves_bb, Pieces::BISHOP, origin_square);
-    add_capture_moves(move_list, capture_moves_bb, Pieces::BISHOP,
-                      origin_square);
+    bitboard bishop_moves =
+        AttackTables::bishop_attacks(origin_square, occupancy) &
+        legal_targets(origin_square);
+    add_moves<type>(move_list, bishop_moves, origin_square);
   }
 }
 
-void MoveGenerator::generate_bishop_captures(MoveList &move_list, bitboard bb) {
-  while (bb) {
-    Square origin_square = Utils::pop_bit(bb);
-    bitboard occupancy = pos->get_occupied();
-    bitboard bishop_moves = generate_diagonal_attacks(occupancy, origin_square);
-
-    bitboard capture_moves_bb = bishop_moves & pos->get_enemy();
-
-    add_capture_moves(move_list, capture_moves_bb, Pieces::BISHOP,
-                      origin_square);
-  }
-}
+template <GenType type>
 void MoveGenerator::generate_queen_moves(MoveList &move_list, bitboard bb) {
   while (bb) {
     Square origin_square = Utils::pop_bit(bb);
     bitboard occupancy = pos->get_occupied();
     bitboard queen_moves =
-        generate_diagonal_attacks(occupancy, origin_square) |
-        generate_rectilinear_attacks(occupancy, origin_square);
-
-    bitboard quiet_moves_bb = queen_moves & pos->get_empty();
-    bitboard capture_moves_bb = queen_moves & pos->get_enemy();
-
-    add_quiet_moves(move_list, quiet_moves_bb, Pieces::QUEEN, origin_square);
-    add_capture_moves(move_list, capture_moves_bb, Pieces::QUEEN,
-                      origin_square);
+        AttackTables::queen_attacks(origin_square, occupancy) &
+        legal_targets(origin_square);
+    add_moves<type>(move_list, queen_moves, origin_square);
   }
 }
 
-void MoveGenerator::generate_queen_captures(MoveList &move_list, bitboard bb) {
-  while (bb) {
-    Square origin_square = Utils::pop_bit(bb);
-    bitboard occupancy = pos->get_occupied();
-    bitboard queen_moves =
-        generate_diagonal_attacks(occupancy, origin_square) |
-        generate_rectilinear_attacks(occupancy, origin_square);
-
-    bitboard capture_moves_bb = queen_moves & pos->get_enemy();
-
-    add_capture_moves(move_list, capture_moves_bb, Pieces::QUEEN,
-                      origin_square);
-  }
-}
-bitboard MoveGenerator::generate_rectilinear_attacks(const bitboard occupancy,
-                                                     const Square sq) const {
-  // uses a routine from the CPW to generate rank attacks
-  size_t file = Utils::file(sq);
-  size_t rank = Utils::rank(sq);
-  size_t index = (occupancy >> rank * 8) & 2 * 63;
-  bitboard attacks = RANK_ATTACKS[4 * index + file];
-  attacks = attacks << (rank * 8);
-
-  // OR rank attakcs with file attakcs from HQ method
-  return attacks | hyperbola_quintessence(occupancy, sq, Utils::file_mask(sq));
-}
-bitboard MoveGenerator::generate_diagonal_attacks(const bitboard occupancy,
-                                                  const Square sq) const {
-  return hyperbola_quintessence(occupancy, sq, Utils::diagonal_mask(sq)) |
-         hyperbola_quintessence(occupancy, sq, Utils::anti_diagonal_mask(sq));
-}
-
+// Castling needs the rights, an empty path between king and rook, and no
+// attacked square on the king's path (including its starting square)
 void MoveGenerator::add_castling_moves(MoveList &move_list) {
-  if (pos->side_to_play == WHITE) {
-    if (pos->castling_flags[0]) {
-      Square rook_square = h1;
-      Square king_target_square = g1;
-
-      bitboard between = Utils::IN_BETWEEN[e1][rook_square];
-      bitboard between_ex = between ^ Utils::set_bit(rook_square);
-      between_ex = between_ex ^ Utils::set_bit(e1);
-
-      if ((between_ex & pos->get_occupied()) == 0) {
-        bool is_path_attacked = false;
-        bitboard potential_attacked = Utils::IN_BETWEEN[king_target_square][e1];
-
-        while (potential_attacked) {
-          Square intermediate_square = Utils::pop_bit(potential_attacked);
-          if ((generate_attackers(intermediate_square) &
-               pos->color_bitboards[~pos->side_to_play]) > 0) {
-            is_path_attacked = true;
-            break;
-          }
-        }
-
-        if (!is_path_attacked && ((between_ex & pos->get_occupied()) == 0)) {
-          Move w_kingside_castle = {};
-          w_kingside_castle.piece = KING;
-          w_kingside_castle.from = e1;
-          w_kingside_castle.to = king_target_square;
-          w_kingside_castle.is_castle = true;
-          move_list.push_back(w_kingside_castle);
-        }
-      }
-    }
-    if (pos->castling_flags[1]) {
-      Square rook_square = a1;
-      Square king_target_square = c1;
-      bitboard between = Utils::IN_BETWEEN[e1][rook_square];
-      bitboard between_ex = between ^ Utils::set_bit(rook_square);
-      between_ex = between_ex ^ Utils::set_bit(e1);
-
-      if ((between_ex & pos->get_occupied()) == 0) {
-        bool is_path_attacked = false;
-        bitboard potential_attacked = Utils::IN_BETWEEN[king_target_square][e1];
-
-        while (potential_attacked) {
-          Square intermediate_square = Utils::pop_bit(potential_attacked);
-          if ((generate_attackers(intermediate_square) &
-               pos->color_bitboards[~pos->side_to_play]) > 0) {
-            is_path_attacked = true;
-            break;
-          }
-        }
-
-        if (!is_path_attacked && ((between_ex & pos->get_occupied()) == 0)) {
-          Move w_kingside_castle = {};
-          w_kingside_castle.piece = KING;
-          w_kingside_castle.from = e1;
-          w_kingside_castle.to = king_target_square;
-          w_kingside_castle.is_castle = true;
-          move_list.push_back(w_kingside_castle);
-        }
-      }
-    }
-
-  } else {
-    if (pos->castling_flags[2]) {
-      Square rook_square = h8;
-      Square king_target_square = g8;
-      bitboard between = Utils::IN_BETWEEN[e8][rook_square];
-      bitboard between_ex = between ^ Utils::set_bit(rook_square);
-      between_ex = between_ex ^ Utils::set_bit(e8);
-      if ((between_ex & pos->get_occupied()) == 0) {
-        bool is_path_attacked = false;
-        bitboard potential_attacked = Utils::IN_BETWEEN[king_target_square][e8];
-
-        while (potential_attacked) {
-          Square intermediate_square = Utils::pop_bit(potential_attacked);
-          if ((generate_attackers(intermediate_square) &
-               pos->color_bitboards[~pos->side_to_play]) > 0) {
-            is_path_attacked = true;
-            break;
-          }
-        }
+  if (checkers) {
+    return;
+  }
 
-        if (!is_path_attacked && ((between_ex & pos->get_occupied()) == 0)) {
-          Move w_kingside_castle = {};
-          w_kingside_castle.piece = KING;
-          w_kingside_castle.from = e8;
-          w_kingside_castle.to = king_target_square;
-          w_kingside_castle.is_castle = true;
-          move_list.push_back(w_kingside_castle);
-        }
-      }
+  size_t first = (pos->side_to_play == WHITE) ? 0 : 2;
+  for (size_t i = first; i < first + 2; i++) {
+    if (!pos->castling_flags[i]) {
+      continue;
     }
-    if (pos->castling_flags[3]) {
-      Square rook_square = a8;
-      Square king_target_square = c8;
-      bitboard between = Utils::IN_BETWEEN[e8][rook_square];
-      bitboard between_ex = between ^ Utils::set_bit(rook_square);
-      between_ex = between_ex ^ Utils::set_bit(e8);
-      if ((between_ex & pos->get_occupied()) == 0) {
-        bool is_path_attacked = false;
-        bitboard potential_attacked = Utils::IN_BETWEEN[king_target_square][e8];
-
-        while (potential_attacked) {
-          Square intermediate_square = Utils::pop_bit(potential_attacked);
-          if ((generate_attackers(intermediate_square) &
-               pos->color_bitboards[~pos->side_to_play]) > 0) {
-            is_path_attacked = true;
-            break;
-          }
-        }
+    const Castling_Data &castle = CASTLING[i];
+    bitboard king_path = Utils::IN_BETWEEN[castle.king][castle.target] |
+                         Utils::set_bit(castle.target);
 
-        if (!is_path_attacked && ((between_ex & pos->get_occupied()) == 0)) {
-          Move w_kingside_castle = {};
-          w_kingside_castle.piece = KING;
-          w_kingside_castle.from = e8;
-          w_kingside_castle.to = king_target_square;
-          w_kingside_castle.is_castle = true;
-          move_list.push_back(w_kingside_castle);
-        }
-      }
+    if ((Utils::IN_BETWEEN[castle.king][castle.rook] & pos->get_occupied()) ||
+        (king_path & king_danger)) {
+      continue;
     }
+    move_list.push_back(Move(castle.king, castle.target, castle.flag));
   }
 }
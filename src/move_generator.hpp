@@ -1,94 +1,103 @@
 #ifndef MOVE_GENERATOR_HPP_
 #define MOVE_GENERATOR_HPP_
 
+#include "attack_tables.hpp"
 #include "datatypes.hpp"
 #include "move_list.hpp"
 #include "position.hpp"
 #include "utils.hpp"
 #include <array>
+#include <atomic>
 #include <memory>
 #include <sstream>
+#include <string>
+#include <vector>
+
+// Which subset of the legal moves a generator emits
+enum GenType : int { CAPTURES, QUIETS, ALL };
 
 class MoveGenerator {
 public:
   MoveGenerator(std::shared_ptr<Position> position_ptr);
   void new_game();
-  double perft(const size_t depth);
-  MoveList generate_pseudo_legal_moves();
+  uint64_t perft(const size_t depth);
   MoveList generate_legal_moves();
   MoveList generate_captures();
-  double divide(const size_t depth);
-  bool validate_gamestate() const;
+  MoveList generate_quiets();
+  bool is_legal(const Move mv);
+  uint64_t divide(const size_t depth, const size_t threads = 1);
+  size_t perft_suite(const std::string &path, const size_t max_depth,
+                     const size_t threads = 1);
   bool king_in_check(const Colors color) const;
+  bitboard discovered_check_candidates() const;
+  bool gives_check(const Move mv, const bitboard discoverers) const;
+  int see(const Move mv) const;
+  bool see_ge(const Move mv, const int threshold) const;
 
-  Pieces inline get_piece_type(const Square sq) {
-    for (int i = PAWN; i < NPIECES; i++) {
-      if (pos->pieces_bitboards[(Pieces)i] & Utils::set_bit(sq)) {
-        return (Pieces)i;
-      }
-    }
-    return PAWN;
+  Pieces inline get_piece_type(const Square sq) const {
+    return pos->board[sq];
   }
 
-  // https://www.chessprogramming.org/Subtracting_a_Rook_from_a_Blocking_Piece
-  bitboard inline hyperbola_quintessence(const bitboard occupancy,
-                                         const Square sq, const bitboard mask) const{
-    // exclude the slider from the mask
-    bitboard mask_ex = mask & (~Utils::set_bit(sq));
-    bitboard x = Utils::set_bit(sq);
-    bitboard o = occupancy & mask_ex;
-    return ((o - x) ^
-            Utils::reverse(Utils::reverse(o) - (0x8000000000000000ull >> sq))) &
-           mask_ex;
-  }
   bitboard inline xray_rectilinear_attacks(const bitboard occupancy,
                                            const bitboard blockers,
                                            const Square sq) const {
-    bitboard attacks = generate_rectilinear_attacks(occupancy, sq);
-    attacks &= blockers;
-    return attacks ^ generate_rectilinear_attacks(occupancy ^ blockers, sq);
+    bitboard attacks = AttackTables::rook_attacks(sq, occupancy);
+    bitboard first_blockers = attacks & blockers;
+    return attacks ^ AttackTables::rook_attacks(sq, occupancy ^ first_blockers);
   }
   bitboard inline xray_diagonal_attacks(const bitboard occupancy,
                                         const bitboard blockers,
-                                        const Square sq) {
-    bitboard attacks = generate_diagonal_attacks(occupancy, sq);
-    attacks &= blockers;
-    return attacks ^ generate_diagonal_attacks(occupancy ^ blockers, sq);
+                                        const Square sq) const {
+    bitboard attacks = AttackTables::bishop_attacks(sq, occupancy);
+    bitboard first_blockers = attacks & blockers;
+    return attacks ^
+           AttackTables::bishop_attacks(sq, occupancy ^ first_blockers);
   }
 
-  bitboard generate_rectilinear_attacks(const bitboard occupancy,
-                                        const Square sq) const;
-  bitboard generate_diagonal_attacks(const bitboard occupancy,
-                                     const Square sq) const;
   void inline add_quiet_moves(MoveList &move_list, bitboard bb,
-                              const Pieces piece, const Square origin) {
+                              const Square origin) {
     while (bb) {
       Square destination_square = Utils::pop_bit(bb);
-      Move quiet_move = {};
-      quiet_move.piece = piece;
-      quiet_move.from = origin;
-      quiet_move.to = destination_square;
-      move_list.push_back(quiet_move);
+      move_list.push_back(Move(origin, destination_square));
     }
   }
 
   void inline add_capture_moves(MoveList &move_list, bitboard bb,
-                                const Pieces piece, const Square origin) {
+                                const Square origin) {
     while (bb) {
       Square destination_square = Utils::pop_bit(bb);
-      Move capture = {};
-      capture.piece = piece;
-      capture.from = origin;
-      capture.to = destination_square;
-      capture.is_capture = true;
-      capture.captured_piece = get_piece_type(capture.to);
-      move_list.push_back(capture);
+      move_list.push_back(Move(origin, destination_square, CAPTURE));
+    }
+  }
+
+  // Splits a target bitboard into quiet moves and captures, as requested
+  template <GenType type>
+  void inline add_moves(MoveList &move_list, const bitboard bb,
+                        const Square origin) {
+    if (type != CAPTURES) {
+      add_quiet_moves(move_list, bb & pos->get_empty(), origin);
+    }
+    if (type != QUIETS) {
+      add_capture_moves(move_list, bb & pos->get_enemy(), origin);
+    }
+  }
+
+  // Adds a pawn move, expanding it into all four promotions on the last rank
+  void inline add_pawn_move(MoveList &move_list, const Square origin,
+                            const Square destination, const uint16_t flags) {
+    if ((Utils::rank(destination) == 7) | (Utils::rank(destination) == 0)) {
+      for (const auto &promotion_piece : PROMOTION_PIECES) {
+        move_list.push_back(
+            Move(origin, destination, flags | promotion_flag(promotion_piece)));
+      }
+    } else {
+      move_list.push_back(Move(origin, destination, flags));
     }
   }
   void add_castling_moves(MoveList &moves_list);
 
   inline Move move_from_string(const std::string &str) {
-    MoveList moves = generate_pseudo_legal_moves();
+    MoveList moves = generate_legal_moves();
     for (size_t i = 0; i < moves.size(); i++) {
       std::stringstream ss;
       ss << moves.at(i);
@@ -101,29 +110,68 @@ public:
   }
 
 private:
+  void count_root_moves(MoveList &move_list,
+                        std::vector<std::atomic<uint64_t>> &counts,
+                        const size_t depth, const size_t threads);
+  template <GenType type> void generate(MoveList &moves_list);
+  template <GenType type>
   void generate_pawn_moves(MoveList &moves_list, bitboard bb);
+  template <GenType type>
   void generate_knight_moves(MoveList &moves_list, bitboard bb);
+  template <GenType type>
   void generate_bishop_moves(MoveList &moves_list, bitboard bb);
+  template <GenType type>
   void generate_rook_moves(MoveList &moves_list, bitboard bb);
+  template <GenType type>
   void generate_queen_moves(MoveList &moves_list, bitboard bb);
+  template <GenType type>
   void generate_king_moves(MoveList &moves_list, bitboard bb);
 
+  void generate_pawn_pushes(MoveList &moves_list, bitboard bb);
   void generate_pawn_captures(MoveList &moves_list, bitboard bb);
-  void generate_knight_captures(MoveList &moves_list, bitboard bb);
-  void generate_bishop_captures(MoveList &moves_list, bitboard bb);
-  void generate_rook_captures(MoveList &moves_list, bitboard bb);
-  void generate_queen_captures(MoveList &moves_list, bitboard bb);
-  void generate_king_captures(MoveList &moves_list, bitboard bb);
-
-  int generate_rank_attack(int occupancy, size_t file) const;
-  void initiate_rank_attacks();
+
   bitboard generate_attackers(const Square sq) const;
-  bitboard generate_pinned_pieces();
+  bitboard generate_attackers(const Square sq, const bitboard occupancy) const;
+  bitboard generate_pinned_pieces() const;
+  bitboard generate_king_danger() const;
+  void update_legality_masks();
+  bool is_legal_en_passant(const Square origin, const Square destination) const;
 
-  std::shared_ptr<Position> pos;
-  std::array<uint8_t, 512> RANK_ATTACKS;
+  // Squares a non-king piece may move to: anything resolving a check, and
+  // only along the king's line when the piece is pinned
+  bitboard inline legal_targets(const Square origin) const {
+    if (pinned & Utils::set_bit(origin)) {
+      return check_mask & Utils::LINE[king_square][origin];
+    }
+    return check_mask;
+  }
 
+  struct Castling_Data {
+    Square king;
+    Square target;
+    Square rook;
+    MoveFlags flag;
+  };
+  // Indexed like Position::castling_flags: K, Q, k, q
+  static constexpr Castling_Data CASTLING[4] = {
+      {e1, g1, h1, KING_CASTLE},
+      {e1, c1, a1, QUEEN_CASTLE},
+      {e8, g8, h8, KING_CASTLE},
+      {e8, c8, a8, QUEEN_CASTLE},
+  };
+  static constexpr Pieces PROMOTION_PIECES[4] = {QUEEN, KNIGHT, ROOK, BISHOP};
+  // Static exchange piece values, the material values of the evaluator
+  static constexpr int SEE_VALUE[NPIECES + 1] = {100, 310, 330, 500,
+                                                 800, 20000, 0};
 
+  std::shared_ptr<Position> pos;
 
+  // Legality masks for the position with key masks_key
+  zobrist_key masks_key;
+  Square king_square;
+  bitboard checkers;
+  bitboard pinned;
+  bitboard check_mask;
+  bitboard king_danger;
 };
 #endif
@@ -1,32 +1,50 @@
 #include "move_list.hpp"
-#include <algorithm>
+#include <utility>
 
-void MoveList::score_moves(Move TT_move, Move killer1, Move killer2) {
+void MoveList::score_moves(const Position &pos, Move TT_move, Move killer1,
+                           Move killer2) {
   for (size_t i = 0; i < this->size(); i++) {
-    Move *move = &this->moves[i];
-    move->sort_score = 0;
+    Move move = this->moves[i];
+    int &score = this->scores[i];
+    score = 0;
 
-    if (move->is_capture) {
-      move->sort_score = MVV_LVA[move->captured_piece][move->piece];
+    if (move.is_capture()) {
+      score = mvv_lva(pos, move);
     } else {
-      if (*move == killer1) {
-        move->sort_score = MoveScores::KILLER1;
+      if (move == killer1) {
+        score = MoveScores::KILLER1;
       }
-      if (*move == killer2) {
-        move->sort_score = MoveScores::KILLER2;
+      if (move == killer2) {
+        score = MoveScores::KILLER2;
       }
     }
 
-    if (*move == TT_move) {
-      move->sort_score = MoveScores::TTMOVE;
+    if (move == TT_move) {
+      score = MoveScores::TTMOVE;
     }
 
-    if (move->promotion > 0) {
-      move->sort_score = MVV_LVA[move->promotion][Pieces::PAWN];
+    if (move.is_promotion()) {
+      score = mvv_lva(pos, move);
     }
   }
 }
 
-void MoveList::sort_moves() {
-  std::sort(this->moves, this->moves + this->size(), CompareMoves());
+// Selection step: swap the best remaining move to the cursor and return it.
+// Cut nodes rarely look past the first few moves, so this beats a full sort.
+// Returns a null Move() once every move has been handed out.
+Move MoveList::next_best() {
+  if (this->cursor >= this->size()) {
+    return Move();
+  }
+
+  size_t best = this->cursor;
+  for (size_t i = this->cursor + 1; i < this->size(); i++) {
+    if (this->scores[i] > this->scores[best]) {
+      best = i;
+    }
+  }
+
+  std::swap(this->moves[this->cursor], this->moves[best]);
+  std::swap(this->scores[this->cursor], this->scores[best]);
+  return this->moves[this->cursor++];
 }
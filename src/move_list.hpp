@@ -1,11 +1,16 @@
 #ifndef MOVE_LIST_HPP_
 #define MOVE_LIST_HPP_
 #include "datatypes.hpp"
+#include "position.hpp"
 
 class MoveList {
 private:
   Move moves[128];
+  // sort scores are kept parallel to moves so a Move stays 16 bits
+  int scores[128];
   size_t count;
+  // index of the next move handed out by next_best()
+  size_t cursor;
 
   enum MoveScores : int {
     TTMOVE = 250,
@@ -26,22 +31,33 @@ private:
   };
 
 public:
-  inline MoveList() { count = 0; }
+  inline MoveList() {
+    count = 0;
+    cursor = 0;
+  }
   constexpr size_t clear() {
     count = 0;
+    cursor = 0;
     return count;
   }
-  inline void push_back(const Move &mv) { moves[count++] = mv; }
+  inline void push_back(const Move mv) { moves[count++] = mv; }
   inline Move &at(const size_t index) { return moves[index]; }
+  inline int score_at(const size_t index) const { return scores[index]; }
+  inline void set_score(const size_t index, const int score) {
+    scores[index] = score;
+  }
   constexpr size_t size() const { return count; }
   constexpr bool empty() const { return count == 0; }
-  void score_moves(Move TT_move, Move killer1, Move killer2);
-  void sort_moves();
-};
+  void score_moves(const Position &pos, Move TT_move, Move killer1,
+                   Move killer2);
+  Move next_best();
 
-struct CompareMoves {
-  inline bool operator()(Move mv1, Move mv2) const {
-    return mv1.sort_score > mv2.sort_score;
+  // MVV-LVA score of a capture, or of the promoted piece for a promotion
+  static int inline mvv_lva(const Position &pos, const Move mv) {
+    if (mv.is_promotion()) {
+      return MVV_LVA[mv.promotion()][Pieces::PAWN];
+    }
+    return MVV_LVA[pos.get_captured_piece(mv)][pos.get_piece_type(mv.from())];
   }
 };
 #endif
@@ -0,0 +1,144 @@
+#include "move_picker.hpp"
+#include "datatypes.hpp"
+#include <algorithm>
+
+MovePicker::MovePicker(MoveGenerator &move_generator, const Position &position,
+                       const Move hash_move, const KillerMoves &killers,
+                       const Move counter, const History &history_tables,
+                       PieceToHistory *const *continuations)
+    : move_gen(move_generator), pos(position), history(&history_tables),
+      stage(TT_MOVE),
+      captures_only(false), TT_move(hash_move), killer1(killers.killer1),
+      killer2(killers.killer2), countermove(counter), bad_capture_index(0) {
+  std::copy(continuations, continuations + History::CONTINUATION_PLIES,
+            conts);
+}
+
+MovePicker::MovePicker(MoveGenerator &move_generator, const Position &position,
+                       const History &history_tables)
+    : move_gen(move_generator), pos(position), history(&history_tables),
+      conts{},
+      stage(GENERATE_CAPTURES),
+      captures_only(true), TT_move(Move()), killer1(Move()), killer2(Move()),
+      countermove(Move()), bad_capture_index(0) {}
+
+// Returns the next move to search, or a null Move() once all are exhausted
+Move MovePicker::next_move() {
+  switch (stage) {
+  case TT_MOVE:
+    stage = GENERATE_CAPTURES;
+    // The hash move may come from a colliding position, verify it first
+    if (TT_move && move_gen.is_legal(TT_move)) {
+      return TT_move;
+    }
+    TT_move = Move();
+    [[fallthrough]];
+
+  case GENERATE_CAPTURES:
+    moves = move_gen.generate_captures();
+    score_captures();
+    stage = CAPTURES;
+    [[fallthrough]];
+
+  case CAPTURES:
+    while (Move mv = moves.next_best()) {
+      if (mv == TT_move) {
+        continue;
+      }
+      // Quiescence prunes losing captures itself, it sees them in order
+      if (!captures_only && !move_gen.see_ge(mv, 0)) {
+        bad_captures.push_back(mv);
+        continue;
+      }
+      return mv;
+    }
+    if (captures_only) {
+      stage = DONE;
+      return Move();
+    }
+    stage = KILLER1;
+    [[fallthrough]];
+
+  case KILLER1:
+    stage = KILLER2;
+    if (killer1 && (killer1 != TT_move) && !killer1.is_capture() &&
+        move_gen.is_legal(killer1)) {
+      return killer1;
+    }
+    killer1 = Move();
+    [[fallthrough]];
+
+  case KILLER2:
+    stage = COUNTERMOVE;
+    if (killer2 && (killer2 != TT_move) && !killer2.is_capture() &&
+        move_gen.is_legal(killer2)) {
+      return killer2;
+    }
+    killer2 = Move();
+    [[fallthrough]];
+
+  case COUNTERMOVE:
+    stage = GENERATE_QUIETS;
+    if (countermove && (countermove != TT_move) && (countermove != killer1) &&
+        (countermove != killer2) && !countermove.is_capture() &&
+        move_gen.is_legal(countermove)) {
+      return countermove;
+    }
+    countermove = Move();
+    [[fallthrough]];
+
+  case GENERATE_QUIETS:
+    moves = move_gen.generate_quiets();
+    score_quiets();
+    stage = QUIETS;
+    [[fallthrough]];
+
+  case QUIETS:
+    while (Move mv = moves.next_best()) {
+      if (!already_picked(mv)) {
+        return mv;
+      }
+    }
+    stage = BAD_CAPTURES;
+    [[fallthrough]];
+
+  case BAD_CAPTURES:
+    // Already in MVV-LVA order from the captures stage
+    if (bad_capture_index < bad_captures.size()) {
+      return bad_captures.at(bad_capture_index++);
+    }
+    stage = DONE;
+    [[fallthrough]];
+
+  case DONE:
+    return Move();
+  }
+  return Move();
+}
+
+// Captures are ordered by MVV-LVA, ties broken by which captures refuted
+// similar positions before
+void MovePicker::score_captures() {
+  for (size_t i = 0; i < moves.size(); i++) {
+    Move mv = moves.at(i);
+    int score = MVV_LVA_WEIGHT * MoveList::mvv_lva(pos, mv);
+    if (mv.is_capture()) {
+      score += history->capture_score(pos.get_piece_type(mv.from()), mv,
+                                      pos.get_captured_piece(mv)) /
+               CAPTURE_HISTORY_DIVISOR;
+    }
+    moves.set_score(i, score);
+  }
+}
+
+// Quiets are ordered by what caused cutoffs elsewhere in the tree
+void MovePicker::score_quiets() {
+  for (size_t i = 0; i < moves.size(); i++) {
+    Move mv = moves.at(i);
+    moves.set_score(i, mv.is_promotion()
+                           ? QUIET_PROMOTION + mv.promotion()
+                           : history->quiet_score(
+                                 pos.side_to_play,
+                                 pos.get_piece_type(mv.from()), mv, conts));
+  }
+}
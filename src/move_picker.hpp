@@ -0,0 +1,78 @@
+#ifndef MOVE_PICKER_HPP_
+#define MOVE_PICKER_HPP_
+
+#include "datatypes.hpp"
+#include "history.hpp"
+#include "move_generator.hpp"
+#include "move_list.hpp"
+#include "position.hpp"
+
+// Staged move picker
+// (https://www.chessprogramming.org/Move_Generation#Staged_Move_Generation)
+// Yields the hash move, then winning captures, then killers and the
+// countermove, then quiet moves and finally losing captures, and only
+// generates a group once every earlier stage has been exhausted, so a cut
+// node that fails high early never pays for quiet move generation.
+class MovePicker {
+public:
+  MovePicker(MoveGenerator &move_generator, const Position &position,
+             const Move hash_move, const KillerMoves &killers,
+             const Move counter, const History &history_tables,
+             PieceToHistory *const *continuations);
+  // Captures only, for quiescence search
+  MovePicker(MoveGenerator &move_generator, const Position &position,
+             const History &history_tables);
+
+  Move next_move();
+
+private:
+  enum Stage : int {
+    TT_MOVE,
+    GENERATE_CAPTURES,
+    CAPTURES,
+    KILLER1,
+    KILLER2,
+    COUNTERMOVE,
+    GENERATE_QUIETS,
+    QUIETS,
+    BAD_CAPTURES,
+    DONE,
+  };
+
+  void score_captures();
+  void score_quiets();
+
+  // Capture history (+-256 after scaling) can reorder attackers, but a
+  // victim step of MVV-LVA (640) always outweighs it
+  static constexpr int MVV_LVA_WEIGHT = 64;
+  static constexpr int CAPTURE_HISTORY_DIVISOR = 64;
+
+  // Quiet promotions go ahead of every history score
+  static constexpr int QUIET_PROMOTION =
+      (History::CONTINUATION_PLIES + 2) * History::MAX_HISTORY;
+
+  // Moves handed out by an earlier stage must not be repeated
+  bool inline already_picked(const Move mv) const {
+    return (mv == TT_move) || (mv == killer1) || (mv == killer2) ||
+           (mv == countermove);
+  }
+
+  MoveGenerator &move_gen;
+  const Position &pos;
+  const History *history;
+  PieceToHistory *conts[History::CONTINUATION_PLIES];
+  Stage stage;
+  bool captures_only;
+
+  Move TT_move;
+  Move killer1;
+  Move killer2;
+  Move countermove;
+  size_t bad_capture_index;
+
+  MoveList moves;
+  // Captures losing material by SEE, deferred until after the quiets
+  MoveList bad_captures;
+};
+
+#endif
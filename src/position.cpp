@@ -147,6 +147,17 @@ int Position::set_board(const std::string &fen) {
       file++;
     }
   }
+  // Mirror the piece bitboards into the mailbox
+  for (auto &piece : board) {
+    piece = NO_PIECE;
+  }
+  for (int i = PAWN; i < NPIECES; i++) {
+    bitboard piece_bb = pieces_bitboards[i];
+    while (piece_bb) {
+      board[Utils::pop_bit(piece_bb)] = (Pieces)i;
+    }
+  }
+
   std::getline(iss, fen_token, ' ');
   if (fen_token == "b") {
     side_to_play = BLACK;
@@ -227,6 +238,10 @@ void Position::undo_null_move() {
   side_to_play = ~side_to_play;
 }
 void Position::make_move(const Move move) {
+  const Square from = move.from();
+  const Square to = move.to();
+  const Pieces piece = get_piece_type(from);
+
   undo_info[ply].key = z_key;
   undo_info[ply].en_passant_square = en_passant_square;
   undo_info[ply].halfmove_clock = halfmove_clock;
@@ -235,17 +250,17 @@ void Position::make_move(const Move move) {
     undo_info[ply].castling_flags[i] = castling_flags[i];
   }
 
-  bitboard from_bitboard = Utils::set_bit(move.from);
-  bitboard to_bitboard = Utils::set_bit(move.to);
+  bitboard from_bitboard = Utils::set_bit(from);
+  bitboard to_bitboard = Utils::set_bit(to);
   bitboard from_to_bitboard = from_bitboard ^ to_bitboard;
 
-  if (move.is_en_passant) {
+  if (move.is_en_passant()) {
     if (side_to_play == WHITE) {
-      remove_pawn((Square)(move.to + S));
-      z_key ^= Zobrist::PIECES[Pieces::PAWN][~side_to_play][move.to + S];
+      remove_pawn((Square)(to + S));
+      z_key ^= Zobrist::PIECES[Pieces::PAWN][~side_to_play][to + S];
     } else {
-      remove_pawn((Square)(move.to + N));
-      z_key ^= Zobrist::PIECES[Pieces::PAWN][~side_to_play][move.to + N];
+      remove_pawn((Square)(to + N));
+      z_key ^= Zobrist::PIECES[Pieces::PAWN][~side_to_play][to + N];
     }
     if (undo_info[ply].en_passant_square != -1) {
       en_passant_square = (Square)-1;
@@ -255,23 +270,23 @@ void Position::make_move(const Move move) {
   }
 
   // zobrist keys are updated here for castle rights
-  update_castling_rights(move.from, move.to, move.is_capture);
-  if (move.is_castle) {
+  update_castling_rights(from, to, move.is_capture());
+  if (move.is_castle()) {
     bitboard rook_from = 0ULL;
     bitboard rook_to = 0ULL;
     bitboard rook_from_to = 0ULL;
     Square rook_from_sq = a1;
     Square rook_to_sq = a1;
-    if (move.to == g1) {
+    if (to == g1) {
       rook_from_sq = h1;
       rook_to_sq = f1;
-    } else if (move.to == c1) {
+    } else if (to == c1) {
       rook_from_sq = a1;
       rook_to_sq = d1;
-    } else if (move.to == g8) {
+    } else if (to == g8) {
       rook_from_sq = h8;
       rook_to_sq = f8;
-    } else if (move.to == c8) {
+    } else if (to == c8) {
       rook_from_sq = a8;
       rook_to_sq = d8;
     }
@@ -280,13 +295,17 @@ void Position::make_move(const Move move) {
     rook_from_to = rook_from ^ rook_to;
     color_bitboards[side_to_play] ^= rook_from_to;
     pieces_bitboards[Pieces::ROOK] ^= rook_from_to;
+    board[rook_from_sq] = NO_PIECE;
+    board[rook_to_sq] = ROOK;
     z_key ^= Zobrist::PIECES[Pieces::ROOK][side_to_play][rook_from_sq];
     z_key ^= Zobrist::PIECES[Pieces::ROOK][side_to_play][rook_to_sq];
   }
 
-  if (!move.is_en_passant && move.is_capture) {
-    remove_piece(move.captured_piece, move.to);
-    z_key ^= Zobrist::PIECES[move.captured_piece][~side_to_play][move.to];
+  if (!move.is_en_passant() && move.is_capture()) {
+    Pieces captured_piece = get_piece_type(to);
+    undo_info[ply].captured_piece = captured_piece;
+    remove_piece(captured_piece, to);
+    z_key ^= Zobrist::PIECES[captured_piece][~side_to_play][to];
   }
 
   if (undo_info[ply].en_passant_square != -1) {
@@ -294,23 +313,33 @@ void Position::make_move(const Move move) {
     z_key ^= Zobrist::EN_PASSANT[Utils::file(undo_info[ply].en_passant_square)];
   }
 
-  if (move.is_double_push) {
-    en_passant_square = (Square)((move.to + move.from) / 2);
+  if (move.is_double_push()) {
+    en_passant_square = (Square)((to + from) / 2);
     z_key ^= Zobrist::EN_PASSANT[Utils::file(en_passant_square)];
   }
 
-  if (!move.promotion) {
-    pieces_bitboards[move.piece] ^= from_to_bitboard;
-    z_key ^= Zobrist::PIECES[move.piece][side_to_play][move.from];
-    z_key ^= Zobrist::PIECES[move.piece][side_to_play][move.to];
+  if (!move.is_promotion()) {
+    pieces_bitboards[piece] ^= from_to_bitboard;
+    board[to] = piece;
+    z_key ^= Zobrist::PIECES[piece][side_to_play][from];
+    z_key ^= Zobrist::PIECES[piece][side_to_play][to];
   } else {
-    pieces_bitboards[move.piece] &= ~from_bitboard;
-    pieces_bitboards[move.promotion] |= to_bitboard;
-    z_key ^= Zobrist::PIECES[move.piece][side_to_play][move.from];
-    z_key ^= Zobrist::PIECES[move.promotion][side_to_play][move.to];
+    pieces_bitboards[piece] &= ~from_bitboard;
+    pieces_bitboards[move.promotion()] |= to_bitboard;
+    board[to] = move.promotion();
+    z_key ^= Zobrist::PIECES[piece][side_to_play][from];
+    z_key ^= Zobrist::PIECES[move.promotion()][side_to_play][to];
   }
+  board[from] = NO_PIECE;
 
-  if ((move.piece == Pieces::PAWN) || (move.is_capture)) {
+  // The child key is final here, start loading its TT cluster so the miss
+  // overlaps with the rest of make_move and the search's own bookkeeping
+  z_key ^= Zobrist::SIDE;
+  if (prefetch) {
+    Utils::prefetch_TT(z_key);
+  }
+
+  if ((piece == Pieces::PAWN) || (move.is_capture())) {
     halfmove_clock = 0;
   } else {
     ++halfmove_clock;
@@ -319,7 +348,6 @@ void Position::make_move(const Move move) {
   // Update color bb, switch side to play
   color_bitboards[side_to_play] ^= from_to_bitboard;
   side_to_play = ~side_to_play;
-  z_key ^= Zobrist::SIDE;
 
   last_move = move;
 
@@ -329,6 +357,11 @@ void Position::make_move(const Move move) {
 void Position::undo_move(const Move move) {
   ply--;
 
+  const Square from = move.from();
+  const Square to = move.to();
+  // the moved piece still sits on its destination square
+  const Pieces piece = move.is_promotion() ? PAWN : get_piece_type(to);
+
   Undo_Info last_move_info = undo_info[ply];
   en_passant_square = last_move_info.en_passant_square;
   for (int i = 0; i < 4; ++i) {
@@ -338,51 +371,54 @@ void Position::undo_move(const Move move) {
   halfmove_clock = last_move_info.halfmove_clock;
   last_move = last_move_info.last_move;
 
-  bitboard from_bitboard = Utils::set_bit(move.to);
-  bitboard to_bitboard = Utils::set_bit(move.from);
+  bitboard from_bitboard = Utils::set_bit(to);
+  bitboard to_bitboard = Utils::set_bit(from);
   bitboard from_to_bitboard = from_bitboard ^ to_bitboard;
 
-  if (move.is_castle) {
-    bitboard rook_from = 0ULL;
-    bitboard rook_to = 0ULL;
-    bitboard rook_from_to = 0ULL;
-    if (move.to == g1) {
-      rook_to = Utils::set_bit(h1);
-      rook_from = Utils::set_bit(f1);
-    } else if (move.to == c1) {
-      rook_to = Utils::set_bit(a1);
-      rook_from = Utils::set_bit(d1);
-    } else if (move.to == g8) {
-      rook_to = Utils::set_bit(h8);
-      rook_from = Utils::set_bit(f8);
-    } else if (move.to == c8) {
-      rook_to = Utils::set_bit(a8);
-      rook_from = Utils::set_bit(d8);
+  if (move.is_castle()) {
+    Square rook_from_sq = a1;
+    Square rook_to_sq = a1;
+    if (to == g1) {
+      rook_to_sq = h1;
+      rook_from_sq = f1;
+    } else if (to == c1) {
+      rook_to_sq = a1;
+      rook_from_sq = d1;
+    } else if (to == g8) {
+      rook_to_sq = h8;
+      rook_from_sq = f8;
+    } else if (to == c8) {
+      rook_to_sq = a8;
+      rook_from_sq = d8;
     }
-    rook_from_to = rook_from ^ rook_to;
+    bitboard rook_from_to =
+        Utils::set_bit(rook_from_sq) ^ Utils::set_bit(rook_to_sq);
     color_bitboards[~side_to_play] ^= rook_from_to;
     pieces_bitboards[Pieces::ROOK] ^= rook_from_to;
+    board[rook_from_sq] = NO_PIECE;
+    board[rook_to_sq] = ROOK;
   }
 
-  if (!move.promotion) {
-    pieces_bitboards[move.piece] ^= from_to_bitboard;
+  if (!move.is_promotion()) {
+    pieces_bitboards[piece] ^= from_to_bitboard;
   } else {
-    pieces_bitboards[move.piece] ^= to_bitboard;
-    pieces_bitboards[move.promotion] ^= from_bitboard;
+    pieces_bitboards[piece] ^= to_bitboard;
+    pieces_bitboards[move.promotion()] ^= from_bitboard;
   }
   color_bitboards[~side_to_play] ^= from_to_bitboard;
+  board[from] = piece;
+  board[to] = NO_PIECE;
 
-  Square captured_square = move.to;
-  if (move.is_en_passant) {
-    if (side_to_play == BLACK) {
-      captured_square = (Square)(captured_square + S);
-    } else {
-      captured_square = (Square)(captured_square + N);
-    }
-  }
-  if (move.is_capture) {
-    Utils::set_bit(pieces_bitboards[move.captured_piece], captured_square);
+  if (move.is_en_passant()) {
+    Square captured_square =
+        (side_to_play == BLACK) ? (Square)(to + S) : (Square)(to + N);
+    Utils::set_bit(pieces_bitboards[Pieces::PAWN], captured_square);
     Utils::set_bit(color_bitboards[side_to_play], captured_square);
+    board[captured_square] = PAWN;
+  } else if (move.is_capture()) {
+    Utils::set_bit(pieces_bitboards[last_move_info.captured_piece], to);
+    Utils::set_bit(color_bitboards[side_to_play], to);
+    board[to] = last_move_info.captured_piece;
   }
   side_to_play = ~side_to_play;
 }
@@ -420,19 +456,8 @@ std::ostream &operator<<(std::ostream &os, const Position &pos) {
     for (int file = 0; file <= 7; file++) {
       int square = Utils::get_square(rank, file);
 
-      size_t color_at_square = -1;
-      size_t piece_at_square = -1;
-      for (size_t color = WHITE; color < NCOLORS; color++) {
-        for (size_t piece = PAWN; piece < NPIECES; piece++) {
-          if (Utils::get_bit(pos.pieces_bitboards[piece] &
-                                 pos.color_bitboards[color],
-                             square)) {
-            piece_at_square = piece;
-            color_at_square = color;
-            break;
-          }
-        }
-      }
+      Pieces piece_at_square = pos.board[square];
+      bool is_black = Utils::get_bit(pos.color_bitboards[BLACK], square);
 
       char identifier = '-';
       switch (piece_at_square) {
@@ -457,7 +482,7 @@ std::ostream &operator<<(std::ostream &os, const Position &pos) {
       default:
         identifier = '-';
       }
-      if (color_at_square == BLACK) {
+      if (is_black) {
         identifier = std::tolower(identifier);
       };
 
@@ -13,6 +13,9 @@ public:
   bitboard pieces_bitboards[NPIECES];
   bitboard color_bitboards[NCOLORS];
 
+  // Mailbox mirror of the bitboards for O(1) piece lookup, NO_PIECE if empty
+  Pieces board[NSQUARES];
+
   // Encoded in FEN string, needed to establish state of play beyond piece
   // arrangement
   Colors side_to_play;
@@ -22,6 +25,10 @@ public:
   size_t ply;
   zobrist_key z_key;
 
+  // Prefetch the child's TT cluster in make_move, only worth it while
+  // searching (perft never probes the TT)
+  bool prefetch = false;
+
   Position();
 
   void new_game();
@@ -33,24 +40,23 @@ public:
   void undo_move(const Move move);
   void make_null_move();
   void undo_null_move();
-  Pieces inline get_piece_type(const Square sq) {
-    for (int i = PAWN; i < NPIECES; i++) {
-      if (pieces_bitboards[(Pieces)i] & Utils::set_bit(sq)) {
-        return (Pieces)i;
-      }
-    }
-    return PAWN;
+  Pieces inline get_piece_type(const Square sq) const { return board[sq]; }
+  // Piece taken by a capture, the en passant pawn is not on the to-square
+  Pieces inline get_captured_piece(const Move mv) const {
+    return mv.is_en_passant() ? PAWN : board[mv.to()];
   }
 
   void inline remove_piece(Pieces pc, const Square sq) {
     bitboard to_remove = 1ULL << sq;
     pieces_bitboards[pc] &= ~to_remove;
     color_bitboards[~side_to_play] &= ~to_remove;
+    board[sq] = NO_PIECE;
   }
   void inline remove_pawn(const Square sq) {
     bitboard to_remove = 1ULL << sq;
     pieces_bitboards[Pieces::PAWN] &= ~to_remove;
     color_bitboards[~side_to_play] &= ~to_remove;
+    board[sq] = NO_PIECE;
   }
 
   void inline update_castling_rights(const Square from, const Square to,
@@ -2,48 +2,123 @@
 #include "datatypes.hpp"
 #include "eval.hpp"
 #include "move_generator.hpp"
+#include "move_picker.hpp"
 #include "utils.hpp"
+#include <algorithm>
 #include <chrono>
+#include <cmath>
+#include <cstdlib>
 #include <limits.h>
 #include <memory>
+#include <sstream>
+#include <thread>
 
 Search::Search(std::shared_ptr<Position> position_ptr)
     : move_gen(std::make_unique<MoveGenerator>(position_ptr)),
-      eval(std::make_unique<Evaluator>(position_ptr)), pos(position_ptr) {
+      eval(std::make_unique<Evaluator>(position_ptr)), pos(position_ptr),
+      history(std::make_unique<History>()),
+      thread_id(0), completed_depth(0), completed_best_move(),
+      stop(std::make_shared<std::atomic<bool>>(false)), pondering(false),
+      ponder_search(false), infinite(false) {
   search_age = 0;
+  history->clear();
+}
+
+int Search::reductions[Utils::MAX_DEPTH + 1][MAX_MOVES];
+
+// Late move reductions grow with log(depth) * log(moves searched), filled
+// once at startup
+void Search::init() {
+  for (size_t d = 1; d <= Utils::MAX_DEPTH; d++) {
+    for (size_t m = 1; m < MAX_MOVES; m++) {
+      reductions[d][m] =
+          static_cast<int>(0.75 + std::log(d) * std::log(m) / 2.25);
+    }
+  }
+}
+
+// Total number of search threads, including this (main) one
+void Search::set_threads(const size_t threads) {
+  helpers.clear();
+  for (size_t i = 1; i < threads; i++) {
+    auto helper = std::make_unique<Search>(std::make_shared<Position>(*pos));
+    helper->thread_id = i;
+    helper->stop = stop;
+    helper->search_age = search_age;
+    helper->margins = margins;
+    helpers.push_back(std::move(helper));
+  }
+}
+
+void Search::set_margins(const PruningMargins &pruning_margins) {
+  margins = pruning_margins;
+  for (auto &helper : helpers) {
+    helper->margins = margins;
+  }
 }
 
 // Re-sets parameters on a search-by-search basis, TT data is preserved
 void Search::new_search() {
-  search_start = std::chrono::high_resolution_clock::now();
   iteration_start = std::chrono::high_resolution_clock::now();
   search_done = false;
+  completed_depth = 0;
+  completed_best_move = Move();
+  pondering = false;
+  ponder_search = false;
+  infinite = false;
+  // Helpers are reset from inside the main search, only the main thread
+  // may lower the shared stop flag
+  if (is_main_thread()) {
+    *stop = false;
+  }
 
   nodes_searched = 0;
   depth_searched = 0;
   time_searched = 0;
-  time_limit = 0;
-
-  hashfull = 0;
+  limits = SearchLimits();
 
   best_move = Move();
   killer_moves.clear();
   killer_moves.resize(Utils::MAX_PLY, {Move(), Move()});
+  stack.assign(Utils::MAX_PLY, StackEntry());
 }
 
 // Re-sets state of object for new games
 void Search::new_game() {
   search_age = 0;
+  history->clear();
   move_gen->new_game();
   new_search();
+  for (auto &helper : helpers) {
+    helper->new_game();
+  }
 }
 
 // Main search loop, iteratively searches at increasing depths until timeout
-int Search::iterative_deepening(const int time, const int moves_remaining) {
-  depth_searched = 1;
+int Search::iterative_deepening() {
+  // Helpers search the same root until the main thread raises the stop flag
+  std::vector<std::thread> workers;
+  if (is_main_thread()) {
+    for (auto &helper : helpers) {
+      *helper->pos = *pos;
+      helper->new_search();
+      SearchLimits helper_limits;
+      helper_limits.infinite = true;
+      helper->set_limits(helper_limits);
+      workers.emplace_back([&helper]() { helper->iterative_deepening(); });
+    }
+  }
+
+  pos->prefetch = true;
+
+  // Odd helpers start one ply deeper so threads desynchronise and fill the
+  // TT with different subtrees
+  depth_searched = 1 + (thread_id & 1);
+  root_ply = pos->ply;
 
   // Aging to prevent old TT entries from lasting forever
   ++search_age;
+  history->age();
 
   int root_eval = -INT_MAX;
 
@@ -51,9 +126,8 @@ int Search::iterative_deepening(const int time, const int moves_remaining) {
   TT_Entry old_entry = probe_TT(pos->z_key, depth_searched);
   best_move = old_entry.best_move;
 
-  // Compute a time limit and begin search
-  time_limit = time / (moves_remaining + 1);
-  search_start = std::chrono::high_resolution_clock::now();
+  // Compute soft and hard time limits and begin search
+  time_manager.start(limits);
 
   // Iterate until timeout or max_depth exceeded
   while (!search_done & (depth_searched < Utils::MAX_DEPTH)) {
@@ -61,58 +135,39 @@ int Search::iterative_deepening(const int time, const int moves_remaining) {
     // Time each iteration to report to UCI
     iteration_start = std::chrono::high_resolution_clock::now();
 
-    // Initialize helper variables, generate and sort moves
+    // Aspiration windows
+    // (https://www.chessprogramming.org/Aspiration_Windows)
+    // Search around the previous score and widen on the failing side until
+    // the score lands inside the window. Mate scores get a full window.
+    int64_t delta = ASPIRATION_WINDOW;
     int alpha = -INT_MAX;
     int beta = INT_MAX;
-    MoveList moves = move_gen->generate_pseudo_legal_moves();
-    moves.score_moves(best_move, Move(), Move());
-    moves.sort_moves();
-
-    // Main search loop, described better in Negamax()
-    for (size_t i = 0; i < moves.size(); i++) {
-      Move mv = moves.at(i);
-      if (depth_searched >= 10) {
-        std::cout << "info currmove " << mv << "\n";
-      }
+    if ((depth_searched >= ASPIRATION_DEPTH) && !is_mate_score(root_eval)) {
+      alpha = std::max<int64_t>(root_eval - delta, -INT_MAX);
+      beta = std::min<int64_t>(root_eval + delta, INT_MAX);
+    }
 
-      pos->make_move(mv);
-      if (!move_gen->validate_gamestate()) {
-        pos->undo_move(mv);
-        continue;
+    while (true) {
+      int eval = negamax_root(alpha, beta, depth_searched);
+      if (search_done) {
+        break;
       }
-      nodes_searched++;
-
-      // Late Move Reductions
-      // (https://www.chessprogramming.org/Late_Move_Reductions)
-      int LMR = 1;
-      // Conditions to reduce (needs tweaks)
-      if ((i > 3) & (depth_searched > 2) & (!mv.is_capture) &
-          (mv.promotion > 0) & (!move_gen->king_in_check(pos->side_to_play))) {
-        // Reduced-depth search
-        root_eval = -negamax(-beta, -alpha, depth_searched - 1 - LMR, true);
-        // If reduced depth search raises alpha, need to re-search
-        if (root_eval > alpha) {
-          root_eval = -negamax(-beta, -alpha, depth_searched - 1, true);
-        }
-        // PVS search based on our current best move
-      } else if (i > 0) {
-        root_eval = -negamax(-alpha - 1, -alpha, depth_searched - 1, true);
-        if ((root_eval > alpha) & (root_eval < beta)) {
-          root_eval = -negamax(-beta, -alpha, depth_searched - 1, true);
-        }
+      delta *= 2;
+      if ((eval <= alpha) && (alpha > -INT_MAX)) {
+        alpha = std::max<int64_t>(alpha - delta, -INT_MAX);
+      } else if ((eval >= beta) && (beta < INT_MAX)) {
+        beta = std::min<int64_t>(beta + delta, INT_MAX);
       } else {
-        root_eval = -negamax(-beta, -alpha, depth_searched - 1, true);
-      }
-
-      pos->undo_move(mv);
-      if (search_done) {
+        root_eval = eval;
         break;
       }
+    }
 
-      if (root_eval > alpha) {
-        alpha = root_eval;
-        best_move = mv;
-      }
+    // Remember this thread's own result before the shared root entry can
+    // be overwritten by another thread
+    if (!search_done) {
+      completed_depth = depth_searched;
+      completed_best_move = best_move;
     }
 
     update_TT(pos->z_key, depth_searched, root_eval, NodeType::EXACT,
@@ -121,14 +176,122 @@ int Search::iterative_deepening(const int time, const int moves_remaining) {
     TT_Entry root_entry = probe_TT(pos->z_key, depth_searched);
     best_move = root_entry.best_move;
     root_eval = root_entry.evaluation;
-    info_to_uci(root_eval);
+    if (is_main_thread()) {
+      info_to_uci(root_eval);
+    }
     ++depth_searched;
+
+    // Do not start an iteration we are unlikely to finish
+    if (is_main_thread() && !search_done && !infinite) {
+      check_ponderhit();
+      if (!pondering && !time_manager.can_start_iteration(time_searched)) {
+        break;
+      }
+    }
+  }
+
+  pos->prefetch = false;
+
+  if (is_main_thread()) {
+    // UCI forbids sending bestmove before stop or ponderhit when pondering
+    // or in infinite mode, even if the search itself has finished
+    while ((infinite || pondering) && !*stop) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+
+    *stop = true;
+    for (std::thread &worker : workers) {
+      worker.join();
+    }
+    // Trust whichever thread finished the deepest iteration, using the move
+    // it recorded then rather than whatever it held when it was stopped
+    if (completed_best_move) {
+      best_move = completed_best_move;
+    }
+    for (auto &helper : helpers) {
+      if (helper->completed_best_move &&
+          (helper->completed_depth > completed_depth)) {
+        completed_depth = helper->completed_depth;
+        best_move = helper->completed_best_move;
+      }
+    }
+
+    // Stopped before a single root move was searched
+    if (!best_move) {
+      MoveList moves = move_gen->generate_legal_moves();
+      best_move = moves.empty() ? Move() : moves.at(0);
+    }
   }
 
   return root_eval;
 }
 
-int Search::negamax(int alpha, int beta, const int depth, bool null_allowed) {
+// Root search inside [alpha, beta], fail-hard like negamax. best_move is
+// updated whenever a root move raises alpha.
+int Search::negamax_root(int alpha, int beta, const int depth) {
+  int root_eval = -INT_MAX;
+  MoveList moves = move_gen->generate_legal_moves();
+  moves.score_moves(*pos, best_move, Move(), Move());
+
+  // Main search loop, described better in Negamax()
+  Move mv;
+  for (size_t i = 0; (mv = moves.next_best()); i++) {
+    if (is_main_thread() && (depth >= 10)) {
+      std::ostringstream currmove;
+      currmove << "info currmove " << mv;
+      Utils::print_line(currmove.str());
+    }
+
+    stack.at(pos->ply).move = mv;
+    stack.at(pos->ply).piece = pos->get_piece_type(mv.from());
+    pos->make_move(mv);
+    nodes_searched++;
+
+    // Late Move Reductions
+    // (https://www.chessprogramming.org/Late_Move_Reductions)
+    // The root is a PV node, reduce one ply less than the table
+    int LMR = std::max(std::min(reduction(depth, i) - 1, depth - 2), 0);
+    if ((i > (size_t)LMR_MOVES) & (depth >= LMR_DEPTH) & (LMR > 0) &
+        (!mv.is_capture()) & (!mv.is_promotion()) &
+        (!move_gen->king_in_check(pos->side_to_play))) {
+      // Reduced-depth search
+      root_eval = -negamax(-beta, -alpha, depth - 1 - LMR, true);
+      // If reduced depth search raises alpha, need to re-search
+      if (root_eval > alpha) {
+        root_eval = -negamax(-beta, -alpha, depth - 1, true);
+      }
+      // PVS search based on our current best move
+    } else if (i > 0) {
+      root_eval = -negamax(-alpha - 1, -alpha, depth - 1, true);
+      if ((root_eval > alpha) & (root_eval < beta)) {
+        root_eval = -negamax(-beta, -alpha, depth - 1, true);
+      }
+    } else {
+      root_eval = -negamax(-beta, -alpha, depth - 1, true);
+    }
+
+    pos->undo_move(mv);
+    if (search_done) {
+      break;
+    }
+
+    // Fail high: the window was too low, this move is better than expected
+    if (root_eval >= beta) {
+      best_move = mv;
+      return beta;
+    }
+
+    if (root_eval > alpha) {
+      alpha = root_eval;
+      best_move = mv;
+    }
+  }
+
+  return alpha;
+}
+
+int Search::negamax(int alpha, int beta, const int depth, bool null_allowed,
+                    const Move excluded) {
   // If we have reached a leaf node, drop into QSearch
   if ((depth <= 0)) {
     return quiescence(alpha, beta);
@@ -139,13 +302,18 @@ int Search::negamax(int alpha, int beta, const int depth, bool null_allowed) {
     return Scores::DRAW;
   }
 
+  // A singular verification search leaves out the hash move, so neither the
+  // TT score nor the TT slot of this position may be used for it
+  const bool singular_search = static_cast<bool>(excluded);
+
   // Probe Transposition Table for a TT-cutoff and/or a hash move
   bool was_found = false;
   TT_Entry entry = probe_TT(pos->z_key, depth, was_found);
-  if (was_found) {
+  if (was_found && !singular_search) {
     if (entry.type == NodeType::EXACT) {
       return entry.evaluation;
-    } else if ((entry.type == NodeType::UPPER) && (entry.evaluation < alpha)) {
+    } else if ((entry.type == NodeType::UPPER) &&
+               (entry.evaluation <= alpha)) {
       return alpha;
     } else if ((entry.type == NodeType::LOWER) && (entry.evaluation >= beta)) {
       return beta;
@@ -153,13 +321,59 @@ int Search::negamax(int alpha, int beta, const int depth, bool null_allowed) {
   }
   // entry.best_move will still contain the hash move from now on
 
+  // Eval-based pruning is unsound in check and never tried on the PV or
+  // near mate scores
+  const bool in_check = move_gen->king_in_check(pos->side_to_play);
+  const bool pv_node = (beta - alpha > 1);
+  const int static_eval = in_check ? -INT_MAX : eval->evaluate();
+  const bool can_prune =
+      !in_check && !pv_node && !is_mate_score(alpha) && !is_mate_score(beta);
+
+  // Improving: our eval went up since our previous move, so this node is
+  // less likely to fail low and is pruned and reduced less
+  stack.at(pos->ply).static_eval = static_eval;
+  const bool improving =
+      !in_check && (static_eval > previous_entry(2).static_eval);
+
+  // Reverse Futility Pruning
+  // (https://www.chessprogramming.org/Reverse_Futility_Pruning)
+  // Static eval is so far above beta that no reply will bring it back
+  if (can_prune && (depth <= REVERSE_FUTILITY_DEPTH) &&
+      (static_eval - margins.reverse_futility * depth >= beta)) {
+    return beta;
+  }
+
+  // Razoring (https://www.chessprogramming.org/Razoring)
+  // Static eval is so far below alpha that only captures could save us,
+  // verify with quiescence and give up if they do not
+  if (can_prune && (depth <= RAZORING_DEPTH) &&
+      (static_eval + margins.razoring * depth < alpha)) {
+    int razor_eval = quiescence(alpha, alpha + 1);
+    if (search_done) {
+      return Scores::DRAW;
+    }
+    if (razor_eval <= alpha) {
+      return alpha;
+    }
+  }
+
+  // Futility Pruning (https://www.chessprogramming.org/Futility_Pruning)
+  // Near the leaves, quiet moves cannot lift a hopeless eval up to alpha
+  const bool futile = can_prune && (depth <= FUTILITY_DEPTH) &&
+                      (static_eval + margins.futility * depth <= alpha);
+  // Checks are never futile, found without making each move
+  const bitboard discoverers =
+      futile ? move_gen->discovered_check_candidates() : 0ULL;
+
   // Null-Move Reduction -
   // (https://www.chessprogramming.org/Null_Move_Reductions) Pass the turn and
   // see if a reduced-depth search still produces a beta cutoff
-  if (!move_gen->king_in_check(pos->side_to_play) & null_allowed &
+  if (!in_check & null_allowed & !singular_search &
           (depth >= NULL_MOVE_REDUCTION + 1) &&
-      (eval->evaluate() >= beta - 50)) {
+      (static_eval >= beta - 50)) {
 
+    stack.at(pos->ply).move = Move();
+    stack.at(pos->ply).piece = NO_PIECE;
     pos->make_null_move();
     int nm_eval =
         -negamax(-beta, -beta + 1, depth - NULL_MOVE_REDUCTION - 1, false);
@@ -182,37 +396,103 @@ int Search::negamax(int alpha, int beta, const int depth, bool null_allowed) {
   Move my_best_move = Move();
   int eval = -INT_MAX;
 
-  // Generate, score, and order moves.
-  MoveList moves = move_gen->generate_pseudo_legal_moves();
-  moves.score_moves(entry.best_move, killer_moves.at(pos->ply).killer1,
-                    killer_moves.at(pos->ply).killer2);
-  moves.sort_moves();
-
-  for (size_t i = 0; i < moves.size(); i++) {
-    Move mv = moves.at(i);
-    pos->make_move(mv);
+  // Continuation tables and the countermove follow from the previous moves
+  const Colors side = pos->side_to_play;
+  const StackEntry prev_move = previous_entry(1);
+  PieceToHistory *conts[History::CONTINUATION_PLIES];
+  for (size_t plies_ago = 0; plies_ago < History::CONTINUATION_PLIES;
+       plies_ago++) {
+    conts[plies_ago] = history->continuation_table(
+        plies_ago, side, previous_entry(plies_ago + 1));
+  }
+  const Move counter = history->countermove(side, prev_move);
+
+  // Moves are generated lazily in stages: hash move, captures, killers,
+  // countermove, quiets
+  MovePicker picker(*move_gen, *pos, entry.best_move,
+                    killer_moves.at(pos->ply), counter, *history, conts);
+  Move quiets[MAX_QUIETS];
+  size_t quiet_count = 0;
+  Move captures[MAX_CAPTURES];
+  size_t capture_count = 0;
+
+  // Extensions stop once the line is twice as long as the iteration depth
+  const bool can_extend = (pos->ply - root_ply) < 2 * depth_searched;
+
+  Move mv;
+  while ((mv = picker.next_move())) {
+    if (mv == excluded) {
+      continue;
+    }
+    const Pieces piece = pos->get_piece_type(mv.from());
+    const int quiet_history =
+        mv.is_capture() ? 0 : history->quiet_score(side, piece, mv, conts);
+
+    // Late Move Pruning
+    // (https://www.chessprogramming.org/Futility_Pruning#MoveCountBasedPruning)
+    // Near the leaves, quiets ordered this late almost never cut
+    if (can_prune && (depth <= LMP_DEPTH) && !mv.is_capture() &&
+        !mv.is_promotion() &&
+        (current_move >= (LMP_BASE + depth * depth) / (improving ? 1 : 2))) {
+      continue;
+    }
 
-    // When making a move, we lose some time by having to check for legality.
-    // We save time overall since more moves are pruned than played,
-    // and psuedo_legal move gen is faster than strictly legal move gen.
-    if (!move_gen->validate_gamestate()) {
-      pos->undo_move(mv);
+    // Skip futile quiets, once a move has been searched so mates are still
+    // told apart from stalemates. Checks are always searched.
+    if (futile && (current_move > 0) && !mv.is_capture() &&
+        !mv.is_promotion() && !move_gen->gives_check(mv, discoverers)) {
       continue;
     }
-    current_move++;
+
+    // Singular Extensions
+    // (https://www.chessprogramming.org/Singular_Extensions)
+    // If every other move fails low against a margin below the hash move's
+    // lower bound, the hash move is the only good one and gets a ply more
+    bool singular = false;
+    if (can_extend && !singular_search && (mv == entry.best_move) &&
+        (depth >= SINGULAR_DEPTH) &&
+        ((entry.type == NodeType::LOWER) || (entry.type == NodeType::EXACT)) &&
+        (entry.depth + SINGULAR_TT_DEPTH >= depth) &&
+        !is_mate_score(entry.evaluation)) {
+      const int singular_beta = entry.evaluation - SINGULAR_MARGIN * depth;
+      const int singular_eval = negamax(singular_beta - 1, singular_beta,
+                                        (depth - 1) / 2, false, mv);
+      if (search_done) {
+        return Scores::DRAW;
+      }
+      singular = (singular_eval < singular_beta);
+    }
+
+    stack.at(pos->ply).move = mv;
+    stack.at(pos->ply).piece = piece;
+    pos->make_move(mv);
+    const bool gives_check = move_gen->king_in_check(pos->side_to_play);
+    // Moves skipped by pruning or exclusion do not count towards LMR or PVS
+    const int moves_searched = current_move++;
     nodes_searched++;
 
+    // Check Extensions (https://www.chessprogramming.org/Check_Extensions)
+    // Forcing lines are resolved at the same nominal depth, at most one ply
+    // per move and only while the line is not yet twice the iteration depth
+    const int extension = (can_extend && (gives_check || singular)) ? 1 : 0;
+    const int new_depth = depth - 1 + extension;
+
     // Late Move Reductions
     // (https://www.chessprogramming.org/Late_Move_Reductions)
-    int LMR = 1;
-    // Conditions for LMR (needs tweaking)
-    if ((i > 3) & (depth_searched > 2) & (!mv.is_capture) & (!mv.promotion) &
-        (!move_gen->king_in_check(pos->side_to_play))) {
+    // Reduce less on the PV, when improving and for quiets with a good
+    // history, more for quiets that keep failing here. The countermove is
+    // not reduced and the reduced search is always at least one ply deep.
+    int LMR = reduction(depth, moves_searched) - pv_node + !improving -
+              quiet_history / HISTORY_REDUCTION_DIVISOR;
+    LMR = std::max(std::min(LMR, depth - 2), 0);
+    if ((moves_searched > LMR_MOVES) & (depth >= LMR_DEPTH) & (LMR > 0) &
+        (!mv.is_capture()) & (!mv.is_promotion()) & (mv != counter) &
+        (!gives_check)) {
       // Reduced-depth search
-      eval = -negamax(-beta, -alpha, depth - 1 - LMR, true);
+      eval = -negamax(-beta, -alpha, new_depth - LMR, true);
       // Need to re-search if our reduced-depth search still raised alpha
       if (eval > alpha) {
-        eval = -negamax(-beta, -alpha, depth - 1, true);
+        eval = -negamax(-beta, -alpha, new_depth, true);
       }
 
       // Principal Variation Search
@@ -220,14 +500,14 @@ int Search::negamax(int alpha, int beta, const int depth, bool null_allowed) {
       // Only search the first move (PV node from TT) at full depth
       // Search subsequent nodes with a null window to test if they could
       // represent an improvement.
-    } else if (i > 0) {
-      eval = -negamax(-alpha - 1, -alpha, depth - 1, true);
+    } else if (moves_searched > 0) {
+      eval = -negamax(-alpha - 1, -alpha, new_depth, true);
       // Identified a move that may be better than our PV, need to re-search
       if ((alpha < eval) & (eval < beta)) {
-        eval = -negamax(-beta, -alpha, depth - 1, true);
+        eval = -negamax(-beta, -alpha, new_depth, true);
       }
     } else {
-      eval = -negamax(-beta, -alpha, depth - 1, true);
+      eval = -negamax(-beta, -alpha, new_depth, true);
     }
 
     pos->undo_move(mv);
@@ -237,11 +517,23 @@ int Search::negamax(int alpha, int beta, const int depth, bool null_allowed) {
 
     // If a move is too good to be true, we return beta
     if (eval >= beta) {
-      // Store the move as a killer and in our TT
-      store_killer(mv);
-      update_TT(move_key, depth, eval, NodeType::LOWER, mv);
+      // Store the move as a killer, in the history tables and in our TT
+      if (!mv.is_capture()) {
+        store_killer(mv);
+        history->store_countermove(side, prev_move, mv);
+        update_quiet_history(mv, quiets, quiet_count, depth, conts);
+      }
+      update_capture_history(mv, captures, capture_count, depth);
+      if (!singular_search) {
+        update_TT(move_key, depth, eval, NodeType::LOWER, mv);
+      }
       return beta;
     }
+    if (!mv.is_capture() && (quiet_count < MAX_QUIETS)) {
+      quiets[quiet_count++] = mv;
+    } else if (mv.is_capture() && (capture_count < MAX_CAPTURES)) {
+      captures[capture_count++] = mv;
+    }
 
     // If we found a new best evaluation, update our best_move and see if we
     // raise alpha
@@ -254,6 +546,11 @@ int Search::negamax(int alpha, int beta, const int depth, bool null_allowed) {
     }
   }
 
+  // Every other move fails low, the excluded one is singular
+  if (singular_search) {
+    return alpha;
+  }
+
   // If we played none of our moves, we are either in stalemate or checkmate
   if (current_move <= 0) {
     if (move_gen->king_in_check(pos->side_to_play)) {
@@ -263,11 +560,12 @@ int Search::negamax(int alpha, int beta, const int depth, bool null_allowed) {
     }
   }
 
-  // Update TT with this position as a PV node if we never raised alpha
-  if (best_eval < alpha_old) {
-    update_TT(move_key, depth, best_eval, NodeType::EXACT, my_best_move);
+  // Every move failed low: best_eval is only an upper bound. Otherwise alpha
+  // was raised by a move inside the window and is the exact score.
+  if (best_eval <= alpha_old) {
+    update_TT(move_key, depth, best_eval, NodeType::UPPER, my_best_move);
   } else {
-    update_TT(move_key, depth, alpha, NodeType::UPPER, my_best_move);
+    update_TT(move_key, depth, alpha, NodeType::EXACT, my_best_move);
   }
 
   // Return alpha as our evaluation of the position
@@ -296,29 +594,35 @@ int Search::quiescence(int alpha, int beta) {
 
   int eval = stand_pat;
 
-  // Generate, score, and sort captures only
-  MoveList moves = move_gen->generate_captures();
-  moves.score_moves(Move(), killer_moves.at(pos->ply).killer1,
-                    killer_moves.at(pos->ply).killer2);
-  moves.sort_moves();
+  // Pick captures only, in MVV-LVA and capture history order
+  MovePicker picker(*move_gen, *pos, *history);
+  Move captures[MAX_CAPTURES];
+  size_t capture_count = 0;
 
   // Recursively search all forcing moves until quiet moves remain
-  for (size_t i = 0; i < moves.size(); i++) {
-    Move mv = moves.at(i);
+  Move mv;
+  while ((mv = picker.next_move())) {
+    // Captures losing material by SEE are very unlikely to raise alpha
+    if (mv.is_capture() && !move_gen->see_ge(mv, 0)) {
+      continue;
+    }
 
     // Same AlphaBeta pattern as in negamax/negamax_root
     pos->make_move(mv);
-    if (!move_gen->validate_gamestate()) {
-      pos->undo_move(mv);
-      continue;
-    }
     nodes_searched++;
     eval = -quiescence(-beta, -alpha);
     pos->undo_move(mv);
 
     if (eval >= beta) {
+      // Not after a stop, the score of a cancelled subtree is meaningless
+      if (!search_done) {
+        update_capture_history(mv, captures, capture_count, 1);
+      }
       return beta;
     }
+    if (mv.is_capture() && (capture_count < MAX_CAPTURES)) {
+      captures[capture_count++] = mv;
+    }
 
     if (eval > alpha) {
       alpha = eval;
@@ -328,62 +632,71 @@ int Search::quiescence(int alpha, int beta) {
   return alpha;
 }
 
-// Age -> Depth replacement scheme Transposition Table
+// Bucketed Age -> Depth replacement scheme Transposition Table
 bool Search::update_TT(const zobrist_key z_key, const size_t depth,
                        const int evaluation, const NodeType type,
                        const Move best_move) {
-  zobrist_key idx = z_key % Utils::TT.size();
-
   // Do not update TT with junk from a cancelled search
   if (search_done) {
     return false;
   }
 
-  // younger means our search is from a new root position
-  bool younger = (search_age > Utils::TT.at(idx).age);
-
-  // Do not overwrite deeper searches unless we are younger
-  if (younger | (Utils::TT.at(idx).depth <= depth)) {
-    Utils::TT.at(idx).key = z_key;
-    Utils::TT.at(idx).depth = depth;
-    Utils::TT.at(idx).evaluation = evaluation;
-    Utils::TT.at(idx).type = type;
-    Utils::TT.at(idx).best_move = best_move;
-    Utils::TT.at(idx).age = search_age;
-    hashfull++;
-    return true;
+  TT_Cluster &cluster = Utils::tt_cluster(z_key);
+  const uint8_t age = search_age;
+
+  // Entries from older searches are evicted first, then the shallowest
+  auto worth = [age](const TT_Entry &slot) {
+    bool current = (slot.type != NONETYPE) && (slot.age == age);
+    return slot.depth + (current ? 256 : 0);
+  };
+
+  TT_Entry *replace = &cluster.entries[0];
+  Move move = best_move;
+  for (TT_Entry &slot : cluster.entries) {
+    // Position is already stored: do not overwrite deeper searches unless
+    // we are younger, and keep its hash move if we have none
+    if (slot.matches(z_key)) {
+      if ((slot.age == age) && (slot.depth > depth)) {
+        return false;
+      }
+      if (!move) {
+        move = slot.best_move;
+      }
+      replace = &slot;
+      break;
+    }
+    if (worth(slot) < worth(*replace)) {
+      replace = &slot;
+    }
   }
 
-  return false;
+  *replace = TT_Entry(z_key, depth, evaluation, type, move, age);
+  return true;
 }
 
 // Probe our TT for an entry containing move and evaluation data
 TT_Entry Search::probe_TT(const zobrist_key z_key, const size_t depth,
                           bool &was_found) {
 
-  // Hash into table
-  zobrist_key idx = z_key % Utils::TT.size();
-  TT_Entry entry = Utils::TT.at(idx);
+  // Hash into table, the whole cluster shares one cache line
+  TT_Cluster &cluster = Utils::tt_cluster(z_key);
 
-  // If the entry does not exist or is a collision
-  if (entry.key != z_key) {
-    // Return a null entry
-    was_found = false;
-    return TT_Entry();
-  }
+  for (const TT_Entry &slot : cluster.entries) {
+    // Copy before verifying, another thread may be writing this slot
+    TT_Entry entry = slot;
+    if (!entry.matches(z_key)) {
+      continue;
+    }
 
-  // If the entry was from a shallower search
-  // Return entry for hash move purposes, do
-  // not use this position for cutoffs or as PV node
-  if ((entry.depth < depth)) {
-    was_found = false;
+    // Entries from a shallower search are only returned for hash move
+    // purposes, deeper ones are also viable for cutoffs
+    was_found = (entry.depth >= depth);
     return entry;
   }
 
-  // If entry exists and from a deeper search
-  // It is viable for cutoffs and TT moves
-  was_found = true;
-  return entry;
+  // No entry, a collision, or one torn by another thread: return a null one
+  was_found = false;
+  return TT_Entry();
 }
 
 // Overload of probe_TT if we aren't performing cut-offs
@@ -393,28 +706,49 @@ TT_Entry Search::probe_TT(const zobrist_key z_key, const size_t depth) {
   return probe_TT(z_key, depth, dummy);
 }
 
-// Check is our search has timed out
-bool Search::is_search_done() const {
-  if (search_done) {
+// Check is our search has timed out or was stopped by the GUI
+bool Search::is_search_done() {
+  if (search_done || *stop) {
     return true;
   }
-  bool times_up = false;
-  // Only calculate elapsed time every 1024 nodes to save cycles
-  if ((nodes_searched & 1023) == 0) {
-    auto curr_time = std::chrono::high_resolution_clock::now();
-    auto search_duration =
-        std::chrono::duration_cast<std::chrono::milliseconds>(curr_time -
-                                                              search_start);
-    if (search_duration.count() > time_limit) {
-      times_up = true;
-    }
+  // Only read the clock every 1024 nodes to save cycles
+  if ((nodes_searched & 1023) != 0) {
+    return false;
+  }
+  check_ponderhit();
+  if (infinite || pondering) {
+    return false;
   }
-  return times_up;
+  return time_manager.hard_limit_reached();
+}
+
+// A ponder search only starts its clock once ponderhit arrives
+void Search::check_ponderhit() {
+  if (ponder_search && !pondering) {
+    ponder_search = false;
+    time_manager.start(limits);
+  }
+}
+
+// Called from the UCI thread while a search is running
+void Search::stop_search() {
+  pondering = false;
+  *stop = true;
+}
+
+void Search::ponderhit() { pondering = false; }
+
+// Set after new_search(), before the search thread is started
+void Search::set_limits(const SearchLimits &search_limits) {
+  limits = search_limits;
+  pondering = limits.ponder;
+  ponder_search = limits.ponder;
+  infinite = limits.infinite;
 }
 
 // Store quiet moves that fail high as "killers"
 void Search::store_killer(Move mv) {
-  if (mv.is_capture) {
+  if (mv.is_capture()) {
     return;
   }
   if (mv == killer_moves.at(pos->ply).killer1) {
@@ -427,6 +761,37 @@ void Search::store_killer(Move mv) {
   killer_moves.at(pos->ply).killer1 = mv;
 }
 
+// Reward the quiet move that caused a cutoff and penalise the quiets that
+// were searched before it without one
+void Search::update_quiet_history(const Move best, const Move *quiets,
+                                  const size_t count, const int depth,
+                                  PieceToHistory *const *conts) {
+  const int bonus = History::bonus(depth);
+  const Colors side = pos->side_to_play;
+  history->update_quiet(side, pos->get_piece_type(best.from()), best, conts,
+                        bonus);
+  for (size_t i = 0; i < count; i++) {
+    history->update_quiet(side, pos->get_piece_type(quiets[i].from()),
+                          quiets[i], conts, -bonus);
+  }
+}
+
+// Reward the capture that caused a cutoff and penalise the captures that
+// were searched before it, best may also be a quiet move
+void Search::update_capture_history(const Move best, const Move *captures,
+                                    const size_t count, const int depth) {
+  const int bonus = History::bonus(depth);
+  if (best.is_capture()) {
+    history->update_capture(pos->get_piece_type(best.from()), best,
+                            pos->get_captured_piece(best), bonus);
+  }
+  for (size_t i = 0; i < count; i++) {
+    history->update_capture(pos->get_piece_type(captures[i].from()),
+                            captures[i], pos->get_captured_piece(captures[i]),
+                            -bonus);
+  }
+}
+
 // Print iterative deepening information to UCI as an "info" message
 void Search::info_to_uci(const int eval) {
   auto end_time = std::chrono::high_resolution_clock::now();
@@ -435,20 +800,22 @@ void Search::info_to_uci(const int eval) {
                       .count();
   time_searched = (time_searched > 0) ? time_searched : 1;
   double nps = nodes_searched / (time_searched / 1000.0);
-  std::cout << "info";
-  std::cout << " depth " << depth_searched;
-  std::cout << " score cp " << eval;
-  std::cout << " nodes " << nodes_searched;
-  std::cout << " nps " << nps;
-  std::cout << " hashfull " << hashfull * 1000 / Utils::TT.size();
-  std::cout << " time " << time_searched;
-  std::cout << " pv ";
+  std::ostringstream info;
+  info << "info";
+  info << " depth " << depth_searched;
+  info << " score cp " << eval;
+  info << " nodes " << nodes_searched;
+  info << " nps " << nps;
+  info << " hashfull " << Utils::hashfull(search_age);
+  info << " time " << time_searched;
+  info << " pv ";
 
   std::vector<Move> pv = {};
   TT_Entry entry = probe_TT(pos->z_key, 0);
-  while (entry.best_move && pv.size() < depth_searched) {
+  while (entry.best_move && pv.size() < depth_searched &&
+         move_gen->is_legal(entry.best_move)) {
     pv.push_back(entry.best_move);
-    std::cout << entry.best_move << "  ";
+    info << entry.best_move << "  ";
     pos->make_move(entry.best_move);
     entry = probe_TT(pos->z_key, 0);
   }
@@ -458,5 +825,5 @@ void Search::info_to_uci(const int eval) {
       pos->undo_move(mv);
     }
   }
-  std::cout << "\n";
+  Utils::print_line(info.str());
 }
@@ -4,16 +4,37 @@
 #include "datatypes.hpp"
 #include "move_generator.hpp"
 #include "eval.hpp"
+#include "history.hpp"
 #include "position.hpp"
+#include "time_manager.hpp"
+#include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <climits>
+#include <cstdlib>
 #include <memory>
 #include <vector>
+// Eval margins of the shallow-depth pruning, per ply of remaining depth,
+// tunable as UCI options
+struct PruningMargins {
+  int reverse_futility = 80;
+  int futility = 100;
+  int razoring = 300;
+};
+
 class Search {
 public:
   Search(std::shared_ptr<Position> position_ptr);
+  static void init();
   void new_game();
-  int iterative_deepening(const int time, const int moves_remaining);
+  void set_threads(const size_t threads);
+  void set_margins(const PruningMargins &pruning_margins);
+  int iterative_deepening();
   void new_search();
+  void set_limits(const SearchLimits &search_limits);
+  void stop_search();
+  void ponderhit();
+  bool inline is_unbounded() const { return infinite || pondering; }
   Move get_best_move() const { return best_move; };
   bool update_TT(const zobrist_key z_key, const size_t depth,
                  const int evaluation, const NodeType type, const Move best_move);
@@ -23,25 +44,92 @@ public:
   
 private:
   void info_to_uci(const int eval);
-  int negamax(int alpha, int beta, const int depth, bool null_allowed);
-  int negamax_root(const int depth);
+  int negamax(int alpha, int beta, const int depth, bool null_allowed,
+              const Move excluded = Move());
+  int negamax_root(int alpha, int beta, const int depth);
   int quiescence(int alpha, int beta);
-  bool is_search_done() const;
+  bool is_search_done();
+  void check_ponderhit();
   void store_killer(Move mv);
+  void update_quiet_history(const Move best, const Move *quiets,
+                            const size_t count, const int depth,
+                            PieceToHistory *const *conts);
+  void update_capture_history(const Move best, const Move *captures,
+                              const size_t count, const int depth);
+  StackEntry inline previous_entry(const size_t plies_ago) const {
+    return (pos->ply > plies_ago) ? stack.at(pos->ply - plies_ago)
+                                  : StackEntry();
+  }
+  bool inline is_main_thread() const { return thread_id == 0; }
+  // Base late move reduction, indexed by depth and moves already searched
+  static int inline reduction(const int depth, const size_t move_count) {
+    return reductions[std::min<size_t>(depth, Utils::MAX_DEPTH)]
+                     [std::min(move_count, MAX_MOVES - 1)];
+  }
+  static bool inline is_mate_score(const int score) {
+    return std::abs(score) >= INT_MAX - (int)Utils::MAX_PLY;
+  }
 
   Move best_move;
   std::unique_ptr<MoveGenerator> move_gen;
   std::unique_ptr<Evaluator> eval;
   std::shared_ptr<Position> pos;
-  int time_limit;
-  std::chrono::time_point<std::chrono::high_resolution_clock> search_start;
+  SearchLimits limits;
+  TimeManager time_manager;
   std::chrono::time_point<std::chrono::high_resolution_clock> iteration_start;
 
   size_t search_age;
 
   std::vector<KillerMoves> killer_moves;
+  std::unique_ptr<History> history;
+  // Moves of the current line indexed by ply, feeds countermoves and
+  // continuation history
+  std::vector<StackEntry> stack;
+  size_t root_ply;
+
+  // Lazy SMP (https://www.chessprogramming.org/Lazy_SMP)
+  // The main search owns the helpers, each with its own position copy,
+  // generator and killers. They only communicate through the shared TT and
+  // the shared stop flag.
+  size_t thread_id;
+  size_t completed_depth;
+  Move completed_best_move;
+  std::vector<std::unique_ptr<Search>> helpers;
+  std::shared_ptr<std::atomic<bool>> stop;
+
+  // UCI go ponder / go infinite, pondering is lowered by ponderhit or stop
+  std::atomic<bool> pondering;
+  bool ponder_search;
+  bool infinite;
+
+  PruningMargins margins;
 
   const int NULL_MOVE_REDUCTION = 2;
+  // Remaining depths up to which eval-based pruning is tried
+  const int REVERSE_FUTILITY_DEPTH = 6;
+  const int FUTILITY_DEPTH = 3;
+  const int RAZORING_DEPTH = 2;
+  // Quiet moves and captures remembered per node for history maluses
+  static constexpr size_t MAX_QUIETS = 64;
+  static constexpr size_t MAX_CAPTURES = 32;
+  // Late move reductions apply from this depth and move index on, and are
+  // one ply smaller per this much combined quiet history
+  const int LMR_DEPTH = 3;
+  static constexpr size_t MAX_MOVES = 64;
+  static int reductions[Utils::MAX_DEPTH + 1][MAX_MOVES];
+  const int LMR_MOVES = 3;
+  const int HISTORY_REDUCTION_DIVISOR = History::MAX_HISTORY / 2;
+  // Late move pruning skips quiets once this many moves have been searched,
+  // (LMP_BASE + depth^2), halved when the eval is not improving
+  const int LMP_DEPTH = 4;
+  const int LMP_BASE = 3;
+  // Singular extensions need a lower bound from a search at most
+  // SINGULAR_TT_DEPTH plies shallower, tested SINGULAR_MARGIN * depth below it
+  const int SINGULAR_DEPTH = 8;
+  const int SINGULAR_TT_DEPTH = 3;
+  const int SINGULAR_MARGIN = 2;
+  const int ASPIRATION_WINDOW = 25;
+  const size_t ASPIRATION_DEPTH = 4;
   const int MAX_DEPTH = 64;
 
   // debug messages
@@ -49,7 +137,6 @@ private:
   size_t time_searched;
   size_t depth_searched;
   bool search_done;
-  size_t hashfull;
 
 };
 
@@ -0,0 +1,44 @@
+#include "time_manager.hpp"
+#include <algorithm>
+#include <limits>
+
+void TimeManager::start(const SearchLimits &limits) {
+  start_time = std::chrono::steady_clock::now();
+  soft_limit = std::numeric_limits<int64_t>::max();
+  hard_limit = std::numeric_limits<int64_t>::max();
+
+  if (limits.infinite) {
+    return;
+  }
+
+  // Fixed time per move: use all of it, minus the network latency
+  if (limits.move_time >= 0) {
+    soft_limit = std::max<int64_t>(limits.move_time - limits.move_overhead, 1);
+    hard_limit = soft_limit;
+    return;
+  }
+
+  if (!limits.has_time) {
+    return;
+  }
+
+  // Never plan on more than 3/4 of what is left on the clock
+  int64_t moves_to_go = (limits.moves_to_go > 0)
+                            ? std::min(limits.moves_to_go, DEFAULT_MOVES_TO_GO)
+                            : DEFAULT_MOVES_TO_GO;
+  // A flagged (negative) clock still gets the 1ms floor, never no limit
+  int64_t budget = std::max<int64_t>(
+      std::max<int64_t>(limits.time, 0) - limits.move_overhead, 1);
+  int64_t ceiling = std::max<int64_t>(budget * 3 / 4, 1);
+
+  soft_limit = std::min(budget / moves_to_go + limits.increment * 3 / 4,
+                        ceiling);
+  hard_limit = std::min(soft_limit * 3, ceiling);
+}
+
+// The next iteration typically costs at least twice the last one; starting
+// it when it cannot finish before the hard limit only wastes the clock
+bool TimeManager::can_start_iteration(const int64_t last_iteration) const {
+  int64_t now = elapsed();
+  return (now < soft_limit) && (now + 2 * last_iteration < hard_limit);
+}
@@ -0,0 +1,44 @@
+#ifndef TIME_MANAGER_HPP_
+#define TIME_MANAGER_HPP_
+
+#include <chrono>
+#include <cstdint>
+
+// Everything a UCI go command can say about how long to think. time is
+// only meaningful with has_time, move_time is -1 if unset.
+struct SearchLimits {
+  bool has_time = false;
+  int64_t time = 0;
+  int64_t increment = 0;
+  int64_t moves_to_go = 0;
+  int64_t move_time = -1;
+  int64_t move_overhead = 0;
+  bool infinite = false;
+  bool ponder = false;
+};
+
+// Time management (https://www.chessprogramming.org/Time_Management)
+// The soft limit decides whether another iteration is worth starting, the
+// hard limit aborts the search mid-iteration as a last resort.
+class TimeManager {
+public:
+  void start(const SearchLimits &limits);
+  bool can_start_iteration(const int64_t last_iteration) const;
+
+  bool inline hard_limit_reached() const { return elapsed() >= hard_limit; }
+  int64_t inline elapsed() const {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::steady_clock::now() - start_time)
+        .count();
+  }
+
+private:
+  // Sudden death games are budgeted as if this many moves remained
+  static constexpr int64_t DEFAULT_MOVES_TO_GO = 30;
+
+  std::chrono::time_point<std::chrono::steady_clock> start_time;
+  int64_t soft_limit;
+  int64_t hard_limit;
+};
+
+#endif
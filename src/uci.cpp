@@ -3,6 +3,7 @@
 #include "move_generator.hpp"
 #include "search.hpp"
 #include "utils.hpp"
+#include <algorithm>
 #include <cctype>
 #include <climits>
 #include <memory>
@@ -16,6 +17,23 @@ Uci::Uci()
   new_game();
 }
 
+Uci::~Uci() {
+  search->stop_search();
+  wait_for_search();
+}
+
+// Commands that touch the position or tables wait for a running go. An
+// infinite or ponder search only ends on stop, which this thread could
+// never read while joining, so it is stopped first.
+void Uci::wait_for_search() {
+  if (search->is_unbounded()) {
+    search->stop_search();
+  }
+  if (search_thread.joinable()) {
+    search_thread.join();
+  }
+}
+
 void Uci::loop() {
   std::string command;
   std::string word;
@@ -30,6 +48,19 @@ void Uci::loop() {
     if (word == "uci") {
       std::cout << "id name lChess 0.1\n";
       std::cout << "id author Luka Andjelic\n";
+      std::cout << "option name Hash type spin default " << Utils::HASH_MB
+                << " min 1 max 65536\n";
+      std::cout << "option name Threads type spin default 1 min 1 max 256\n";
+      std::cout << "option name Move Overhead type spin default "
+                << DEFAULT_MOVE_OVERHEAD << " min 0 max 5000\n";
+      std::cout << "option name PerftHash type spin default "
+                << Utils::PERFT_HASH_MB << " min 0 max 65536\n";
+      std::cout << "option name RFPMargin type spin default "
+                << margins.reverse_futility << " min 0 max 1000\n";
+      std::cout << "option name FutilityMargin type spin default "
+                << margins.futility << " min 0 max 1000\n";
+      std::cout << "option name RazorMargin type spin default "
+                << margins.razoring << " min 0 max 2000\n";
       std::cout << "uciok" << std::endl;
     }
 
@@ -37,7 +68,22 @@ void Uci::loop() {
       std::cout << "readyok" << std::endl;
     }
 
+    if (word == "stop") {
+      search->stop_search();
+    }
+
+    if (word == "ponderhit") {
+      search->ponderhit();
+    }
+
+    if (word == "setoption") {
+      wait_for_search();
+      std::getline(iss, word);
+      parse_option(word);
+    }
+
     if (word == "position") {
+      wait_for_search();
       std::getline(iss, word, ' ');
       if (word == "startpos") {
         pos->set_board(Utils::STARTING_FEN_POSITION);
@@ -51,68 +97,145 @@ void Uci::loop() {
           continue;
         }
         Move mv = move_gen->move_from_string(word);
-        pos->make_move(mv);
+        if (mv) {
+          pos->make_move(mv);
+        }
       }
     }
     if (word == "go") {
+      wait_for_search();
       std::getline(iss, word);
       parse_go(word);
     }
+    if (word == "perftsuite") {
+      // perftsuite <file> [depth <n>] [threads <n>]
+      std::string path;
+      size_t depth = Utils::MAX_DEPTH;
+      size_t threads = 1;
+      iss >> path;
+      while (iss >> word) {
+        if (word == "depth") {
+          iss >> depth;
+        } else if (word == "threads") {
+          iss >> threads;
+        }
+      }
+      wait_for_search();
+      move_gen->perft_suite(path, depth, threads);
+    }
     if (word == "print") {
+      wait_for_search();
       std::cout << *pos << std::endl;
     }
     if (word == "ucinewgame") {
+      wait_for_search();
       new_game();
     }
     if (word == "quit") {
       break;
     }
   }
+  // quit or input closed: nobody is left to read a bestmove
+  search->stop_search();
+  wait_for_search();
 }
 
-void Uci::parse_go(const std::string &go) const {
+// Parses the go command on the input thread, then runs the search (or
+// perft) on search_thread and returns to reading commands
+void Uci::parse_go(const std::string &go) {
   std::istringstream iss(go);
   std::string token;
-  std::getline(iss, token, ' ');
-  int time = INT_MAX;
-  int moves_remaining = 40;
-
-  if (isdigit(token[0])) {
-    int multiplier = std::stoi(token);
-    time = 100 * multiplier;
-    moves_remaining = 1;
-  } else if (token == "movetime") {
-      std::getline(iss, token, ' ');
-      time = std::stoi(token);
-      moves_remaining = 1;
-  } else {
-    if (token == "wtime") {
-      std::getline(iss, token, ' ');
-      if (pos->side_to_play == WHITE) {
-        time = std::stoi(token);
-      }
-      std::getline(iss, token, ' ');
-    }
-    if (token == "btime") {
-      std::getline(iss, token, ' ');
-      if (pos->side_to_play == BLACK) {
-        time = std::stoi(token);
+  SearchLimits limits;
+  limits.move_overhead = move_overhead;
+  int64_t clock[NCOLORS] = {0, 0};
+  int64_t increment[NCOLORS] = {0, 0};
+  bool has_clock[NCOLORS] = {false, false};
+
+  while (iss >> token) {
+    if (isdigit(token[0])) {
+      limits.move_time = 100 * std::stoll(token);
+    } else if (token == "movetime") {
+      iss >> limits.move_time;
+    } else if (token == "wtime") {
+      iss >> clock[WHITE];
+      has_clock[WHITE] = true;
+    } else if (token == "btime") {
+      iss >> clock[BLACK];
+      has_clock[BLACK] = true;
+    } else if (token == "winc") {
+      iss >> increment[WHITE];
+    } else if (token == "binc") {
+      iss >> increment[BLACK];
+    } else if (token == "movestogo") {
+      iss >> limits.moves_to_go;
+    } else if (token == "ponder") {
+      limits.ponder = true;
+    } else if (token == "infinite") {
+      limits.infinite = true;
+    } else if (token == "perft") {
+      // go perft <depth> [threads <n>]
+      size_t depth;
+      size_t threads = 1;
+      iss >> depth;
+      if ((iss >> token) && (token == "threads")) {
+        iss >> threads;
       }
-    std::getline(iss, token, ' ');
-    }
-    if (token == "movestogo") {
-      std::getline(iss, token, ' ');
-      moves_remaining = std::stoi(token);
+      search_thread = std::thread(
+          [this, depth, threads]() { move_gen->divide(depth, threads); });
+      return;
     }
   }
-  if (token == "perft") {
-    std::getline(iss, token, ' ');
-    move_gen->divide(std::stoi(token));
-  } else {
-    search->new_search();
-    search->iterative_deepening(time, moves_remaining);
-    std::cout << "bestmove " << search->get_best_move();
-    std::cout << std::endl;
+
+  // Any clock means a timed game, even a negative one. If only the
+  // opponent's clock was sent, budget as if ours showed the same.
+  const Colors us = pos->side_to_play;
+  const Colors side = has_clock[us] ? us : ~us;
+  if (has_clock[side]) {
+    limits.has_time = true;
+    limits.time = std::max<int64_t>(clock[side], 0);
+    limits.increment = increment[side];
+  }
+
+  search->new_search();
+  search->set_limits(limits);
+  search_thread = std::thread([this]() {
+    search->iterative_deepening();
+    std::ostringstream bestmove;
+    bestmove << "bestmove " << search->get_best_move();
+    Utils::print_line(bestmove.str());
+  });
+}
+
+// setoption name <id> value <x>
+void Uci::parse_option(const std::string &option) {
+  std::istringstream iss(option);
+  std::string token;
+  std::string name;
+  std::string value;
+
+  iss >> token;
+  while ((iss >> token) && (token != "value")) {
+    name += (name.empty() ? "" : " ") + token;
+  }
+  iss >> value;
+
+  if (name == "Hash") {
+    Utils::resize_TT(std::stoul(value));
+  } else if (name == "Move Overhead") {
+    move_overhead = std::stoll(value);
+  } else if (name == "Threads") {
+    search->set_threads(std::stoul(value));
+  } else if (name == "PerftHash") {
+    Utils::resize_perft_TT(std::stoul(value));
+  } else if (name == "RFPMargin") {
+    margins.reverse_futility = std::stoi(value);
+    search->set_margins(margins);
+  } else if (name == "FutilityMargin") {
+    margins.futility = std::stoi(value);
+    search->set_margins(margins);
+  } else if (name == "RazorMargin") {
+    margins.razoring = std::stoi(value);
+    search->set_margins(margins);
   }
 }
 
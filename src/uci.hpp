@@ -5,12 +5,15 @@
 #include "position.hpp"
 #include "search.hpp"
 #include <memory>
+#include <thread>
 
 class Uci {
 public:
   Uci();
+  ~Uci();
   void loop();
-  void parse_go(const std::string &go) const;
+  void parse_go(const std::string &go);
+  void parse_option(const std::string &option);
   void new_game();
 
 private:
@@ -18,6 +21,17 @@ private:
   std::unique_ptr<MoveGenerator> move_gen;
   std::unique_ptr<Search> search;
 
+  // Milliseconds reserved per move for GUI and network latency
+  static constexpr int64_t DEFAULT_MOVE_OVERHEAD = 30;
+  int64_t move_overhead = DEFAULT_MOVE_OVERHEAD;
+
+  // Shallow-depth pruning margins, handed to the search on setoption
+  PruningMargins margins;
+
+  // go runs here so stop, ponderhit and isready are read while thinking
+  std::thread search_thread;
+  void wait_for_search();
+
 }; // namespace UCI
 
 #endif
@@ -1,55 +1,118 @@
 #include "utils.hpp"
 #include "datatypes.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <memory>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
 
 namespace Utils {
 bitboard IN_BETWEEN[64][64];
-std::vector<TT_Entry> TT;
+bitboard LINE[64][64];
+TT_Cluster *TT = nullptr;
+size_t TT_SIZE = 0;
+std::vector<Perft_Entry> PERFT_TT(PERFT_HASH_MB * 1024 * 1024 /
+                                  sizeof(Perft_Entry));
 
 }
 void Utils::init() {
   generate_in_between();
+  if (TT == nullptr) {
+    resize_TT(HASH_MB);
+  } else {
+    clear_TT();
+  }
+  clear_perft_TT();
+}
+
+// The table is 2 MB aligned and, on Linux, flagged for transparent huge
+// pages, so a 128 MB table needs 64 TLB entries instead of 32768
+void Utils::resize_TT(const size_t megabytes) {
+  constexpr size_t HUGE_PAGE = 2 * 1024 * 1024;
+  size_t bytes = std::max<size_t>(megabytes, 1) * 1024 * 1024;
+  bytes = (bytes + HUGE_PAGE - 1) / HUGE_PAGE * HUGE_PAGE;
+
+  std::free(TT);
+  TT = static_cast<TT_Cluster *>(std::aligned_alloc(HUGE_PAGE, bytes));
+  if (TT == nullptr) {
+    std::cerr << "info string failed to allocate " << megabytes << "MB TT\n";
+    std::exit(EXIT_FAILURE);
+  }
+#ifdef __linux__
+  madvise(TT, bytes, MADV_HUGEPAGE);
+#endif
+  TT_SIZE = bytes / sizeof(TT_Cluster);
   clear_TT();
 }
 
+// Clearing also faults the pages in, split it over every core so
+// ucinewgame does not stall on a large table
+void Utils::clear_TT() {
+  size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  size_t chunk = (TT_SIZE + threads - 1) / threads;
+  std::vector<std::thread> workers;
+  for (size_t t = 0; t < threads; t++) {
+    size_t start = std::min(t * chunk, TT_SIZE);
+    size_t end = std::min(start + chunk, TT_SIZE);
+    workers.emplace_back([start, end]() {
+      std::uninitialized_fill(TT + start, TT + end, TT_Cluster());
+    });
+  }
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+}
+
+// IN_BETWEEN[i][j] holds the squares strictly between two aligned squares,
+// LINE[i][j] the whole rank, file or diagonal running through both of them
 void Utils::generate_in_between() {
   for (size_t i = 0; i < NSQUARES; i++) {
     for (size_t j = 0; j < NSQUARES; j++) {
-      bitboard between = 0ULL;
+      IN_BETWEEN[i][j] = 0ULL;
+      LINE[i][j] = 0ULL;
 
-      size_t rank_i = Utils::rank((Square)i);
-      size_t rank_j = Utils::rank((Square)j);
-      size_t min_rank = std::min(rank_i, rank_j);
-      size_t max_rank = std::max(rank_i, rank_j);
+      int rank_i = Utils::rank((Square)i);
+      int rank_j = Utils::rank((Square)j);
+      int file_i = Utils::file((Square)i);
+      int file_j = Utils::file((Square)j);
+      int rank_distance = std::abs(rank_j - rank_i);
+      int file_distance = std::abs(file_j - file_i);
 
-      size_t file_i = Utils::file((Square)i);
-      size_t file_j = Utils::file((Square)j);
-      size_t min_file = std::min(file_i, file_j);
-      size_t max_file = std::max(file_i, file_j);
-
-      if (file_i == file_j) {
-        for (size_t rank = min_rank; rank <= max_rank; rank++) {
-          Square sq = Utils::get_square(rank, file_i);
-          between |= Utils::set_bit(sq);
-        }
+      bool is_aligned = (rank_distance == 0) || (file_distance == 0) ||
+                        (rank_distance == file_distance);
+      if ((i == j) || !is_aligned) {
+        continue;
       }
-      if (rank_i == rank_j) {
-        for (size_t file = min_file; file <= max_file; file++) {
-          Square sq = (Square)Utils::get_square(rank_i, file);
-          between |= Utils::set_bit(sq);
-        }
+
+      // Unit step from i towards j along their shared ray
+      int rank_step = (rank_j > rank_i) - (rank_j < rank_i);
+      int file_step = (file_j > file_i) - (file_j < file_i);
+
+      bitboard between = 0ULL;
+      int rank = rank_i + rank_step;
+      int file = file_i + file_step;
+      while ((rank != rank_j) || (file != file_j)) {
+        Utils::set_bit(between, Utils::get_square(rank, file));
+        rank += rank_step;
+        file += file_step;
       }
-      if ((max_rank - min_rank) == (max_file - min_file)) {
-        bool is_positive_diagonal = (file_j - file_i == rank_j - rank_i);
-
-        size_t file = is_positive_diagonal ? min_file : max_file;
-        for (size_t rank = min_rank; rank <= max_rank; rank++) {
-          Square sq = Utils::get_square(file, file);
-          between |= Utils::set_bit(sq);
-          is_positive_diagonal ? file++ : file--;
+      IN_BETWEEN[i][j] = between;
+
+      // Extend the ray through i in both directions to the board edges
+      bitboard line = Utils::set_bit(i);
+      for (int direction : {1, -1}) {
+        rank = rank_i + direction * rank_step;
+        file = file_i + direction * file_step;
+        while ((rank >= 0) && (rank <= 7) && (file >= 0) && (file <= 7)) {
+          Utils::set_bit(line, Utils::get_square(rank, file));
+          rank += direction * rank_step;
+          file += direction * file_step;
         }
       }
-      IN_BETWEEN[i][j] = between;
+      LINE[i][j] = line;
     }
   }
 }
-
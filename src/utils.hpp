@@ -2,6 +2,7 @@
 #define UTILS_HPP_
 
 #include "datatypes.hpp"
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <vector>
@@ -51,13 +52,46 @@ inline bitboard anti_diagonal_mask(Square square) {
 /////////////////////////
 /* Transposition Table */
 /////////////////////////
-const size_t HASHSIZE = 128 * 1024 * 1024 / sizeof(TT_Entry);
-extern std::vector<TT_Entry> TT;
+// Size in MB, changed at runtime with the Hash UCI option
+const size_t HASH_MB = 128;
+extern TT_Cluster *TT;
+extern size_t TT_SIZE;
+
+// Multiply-shift indexing maps the key onto [0, TT_SIZE) without a
+// division, using the high key bits (TT_Entry keeps the low ones)
+__extension__ typedef unsigned __int128 uint128;
+inline TT_Cluster &tt_cluster(const zobrist_key key) {
+  return TT[(static_cast<uint128>(key) * TT_SIZE) >> 64];
+}
+
+// Software prefetch (https://www.chessprogramming.org/Transposition_Table)
+inline void prefetch_TT(const zobrist_key key) {
+  __builtin_prefetch(&tt_cluster(key));
+}
+
+// Permille of a sample of entries written during the current search
+inline size_t hashfull(const uint8_t age) {
+  size_t samples = std::min<size_t>(1000, TT_SIZE);
+  size_t used = 0;
+  for (size_t i = 0; i < samples; i++) {
+    for (const TT_Entry &entry : TT[i].entries) {
+      used += (entry.type != NONETYPE) && (entry.age == age);
+    }
+  }
+  return used * 1000 / (samples * TT_Cluster::SIZE);
+}
+
+// Perft-only table, kept apart from the search TT so movegen validation
+// runs never pollute (or get polluted by) search entries. Size is set with
+// the PerftHash UCI option, 0 disables it.
+const size_t PERFT_HASH_MB = 16;
+extern std::vector<Perft_Entry> PERFT_TT;
 
 ///////////////////////////////
 /* Bitboard Helper Functions */
 ///////////////////////////////
 extern bitboard IN_BETWEEN[64][64];
+extern bitboard LINE[64][64];
 inline bitboard get_bit(const bitboard bitboard, const int index) {
   return bitboard & (1ULL << index);
 }
@@ -76,20 +110,15 @@ inline size_t pop_count(bitboard bb) {
   }
   return count;
 }
-inline bitboard reverse(bitboard bb) {
-  bb =
-      ((bb >> 8) & 0x00FF00FF00FF00FFULL) | ((bb << 8) & 0xFF00FF00FF00FF00ULL);
-  bb = ((bb >> 16) & 0x0000FFFF0000FFFFULL) |
-       ((bb << 16) & 0xFFFF0000FFFF0000ULL);
-  bb = ((bb >> 32) & 0x00000000FFFFFFFFULL) |
-       ((bb << 32) & 0xFFFFFFFF00000000ULL);
-  return bb;
-}
 inline Square pop_bit(bitboard &bb) {
   Square output = lsb(bb);
   bb &= bb - 1;
   return output;
 }
+// The search and input threads share stdout, and with unitbuf every << is
+// flushed on its own. Output is therefore built up front and handed over in
+// a single write, so a readyok can never land in the middle of a line.
+inline void print_line(const std::string &text) { std::cout << text + "\n"; }
 inline void print_bitboard(const bitboard bitboard) {
   std::cout << "\n";
   for (int rank = 7; rank >= 0; rank--) {
@@ -107,9 +136,15 @@ inline void print_bitboard(const bitboard bitboard) {
 /* Initialize Static Tables */
 //////////////////////////////
 void init();
-void inline clear_TT() {
-  TT.clear();
-  TT.resize(HASHSIZE, TT_Entry());
+void resize_TT(const size_t megabytes);
+void clear_TT();
+void inline clear_perft_TT() {
+  std::fill(PERFT_TT.begin(), PERFT_TT.end(), Perft_Entry());
+}
+void inline resize_perft_TT(const size_t megabytes) {
+  PERFT_TT.assign(megabytes * 1024 * 1024 / sizeof(Perft_Entry),
+                  Perft_Entry());
+  PERFT_TT.shrink_to_fit();
 }
 void generate_in_between();
 